@@ -2,8 +2,13 @@
 
 #include "../include/Rendering/Renderer.h"
 #include "../include/Fluid/Fluid.h"
+#include "../include/Fluid/TrajectoryRecorder.h"
+#include "../include/Network/StreamServer.h"
+#include "../include/Network/MetricsServer.h"
+#include "../include/Utility/Metrics.h"
 
 #include <string>
+#include <vector>
 
 enum ApplicationState
 {
@@ -19,6 +24,80 @@ public:
 
     int run();
 
+    /**
+     * Runs the default scene for numSteps with different thread counts and grid types
+     * and checks every run ends up bitwise identical, instead of running interactively.
+     *
+     * @return 0 if every run was identical.
+     */
+    int verifyDeterminism(int numSteps);
+
+    /**
+     * Times numSteps of dt seconds of the default scene with numParticles particles at the precision the fluid was built with,
+     * instead of running interactively.
+     *
+     * The final positions are written to referencePath if it doesn't exist, otherwise they are compared against it,
+     * so a double precision run can be used as the reference for reduced precision builds.
+     *
+     * @return 0 unless the reference couldn't be read or written.
+     */
+    int benchmark(int numSteps, int numParticles, float dt, const std::string &referencePath = "");
+
+    /**
+     * Sets how the fluid solves pressure, must be called before run, benchmark or verifyDeterminism.
+     */
+    void setSolver(Fluid::SolverType solver);
+
+    /**
+     * Sets the fluid's viscosity, must be called before run, benchmark or verifyDeterminism.
+     *
+     * @param implicit If true viscosity is solved implicitly, which high viscosities need to stay stable.
+     */
+    void setViscosity(float viscosity, bool implicit);
+
+    /**
+     * Exports frames instead of running interactively, must be called before run.
+     *
+     * The simulation runs unpaused and as fast as frames can be exported, then exits after numFrames frames.
+     *
+     * @param headless If true no window is opened.
+     */
+    void setExport(const Rendering::ExportOptions &exportOptions, int numFrames, bool headless);
+
+    /**
+     * Publishes every step into shared memory with the given name, must be called before run.
+     */
+    void setPublish(const std::string &name);
+
+    /**
+     * Streams every step to viewers connecting on the given port, must be called before run.
+     *
+     * @param headless If true no window is opened and the simulation runs unpaused.
+     */
+    void setServe(unsigned short port, bool headless);
+
+    /**
+     * Sets how particles are drawn, must be called before run.
+     * The software backends export frames without touching the GPU, so --headless --export works without a GL context.
+     */
+    void setCirclesBackend(Rendering::CirclesBackend backend);
+
+    /**
+     * Guards the simulation with a watchdog that rolls back blow ups, must be called before run.
+     * Headless runs exit if the watchdog can't recover.
+     */
+    void setWatchdog(bool enabled);
+
+    /**
+     * Appends every step's diagnostics to a CSV file, must be called before run.
+     */
+    void setDiagnostics(const std::string &path);
+
+    /**
+     * Serves metrics over HTTP on localhost at the given port, must be called before run.
+     */
+    void setMetrics(unsigned short port);
+
 private:
     std::string windowTitle;
     int windowWidth;
@@ -29,17 +108,37 @@ private:
     int init();
     void destroy();
 
-    Rendering::Renderer *renderer;
+    Rendering::Renderer *renderer = nullptr;
 
     Fluid::FluidOptions options;
-    Fluid::Fluid *fluid;
+    Fluid::SolverType solver = Fluid::SolverType::SPH_SOLVER;
+    float viscosity = 0.13f;
+    bool implicitViscosity = false;
+    Fluid::Fluid *fluid = nullptr;
+    void createOptions();
 
     void update(float dt);
     void render(bool clear = true);
 
-    Rendering::Color getParticleColor(Fluid::Particle *particle);
+    Rendering::Color getParticleColor(float speedSqr);
+
+    // particle colors by speed squared, so extraction is a lookup rather than a blend per particle
+    static const int PARTICLE_COLOR_LUT_SIZE = 4096;
+    static constexpr float PARTICLE_COLOR_LUT_MAX_SPEED = 700.0f;
+    Rendering::Color particleColorLut[PARTICLE_COLOR_LUT_SIZE];
+    void createParticleColorLut();
+
+    // what the renderer draws, kept between frames and filled straight from the particles
+    std::vector<Rendering::Circle> renderCircles;
+    std::vector<Rendering::Color> renderColors;
+    void extractRenderData();
+    void extractRenderDataThread(int startingParticle, int endingParticle);
 
     bool enablePerPixelDensity = false;
+
+    // debug mode overlays
+    bool enableOccupancyHeatmap = false;
+    bool enableThreadPartitions = false;
     void renderPerPixelDensity(unsigned int skip);
 
     bool paused = true;
@@ -49,9 +148,70 @@ private:
 
     glm::vec2 mousePos;
     bool isAttractorActive = false;
-    Fluid::FluidAttractor *attractor = nullptr;
+    Fluid::FluidAttractor attractor;
+    Fluid::FluidAttractorHandle attractorHandle;
 
     void createFluidInteractionListener();
 
+    bool enableObstacles = false;
+    Fluid::ObstacleField *obstacles = nullptr;
+    void createObstacles();
+    void renderObstacles();
+
     void createGui();
+
+    Fluid::TrajectoryRecorder *recorder = nullptr;
+    void toggleRecording();
+
+    bool exporting = false;
+    bool headless = false;
+    int exportFrames = 0;
+    Rendering::ExportOptions exportOptions;
+
+    std::string publishName;
+    std::string diagnosticsPath;
+    bool useWatchdog = false;
+    Rendering::CirclesBackend circlesBackend = Rendering::CirclesBackend::BATCHED_CIRCLES;
+
+    unsigned short servePort = 0;
+    Network::StreamServer *server = nullptr;
+
+    unsigned short metricsPort = 0;
+    Utility::MetricsRegistry metrics;
+    Network::MetricsServer *metricsServer = nullptr;
+
+    // neighbours and grid occupancy need a pass over every particle so are only sampled every few steps
+    static const int METRICS_SAMPLE_INTERVAL = 10;
+    int metricsStep = 0;
+
+    Utility::Histogram *phaseMetrics[Fluid::NUM_PHASES];
+    Utility::Histogram *stepMetric;
+    Utility::Histogram *neighboursMetric;
+    Utility::Gauge *particlesMetric;
+    Utility::Gauge *occupiedCellsMetric;
+    Utility::Gauge *meanOccupancyMetric;
+    Utility::Gauge *maxOccupancyMetric;
+    Utility::Gauge *gridChurnMetric;
+    Utility::Gauge *solverIterationsMetric;
+    Utility::Gauge *viscosityIterationsMetric;
+    Utility::Gauge *kineticEnergyMetric;
+    Utility::Gauge *potentialEnergyMetric;
+    Utility::Gauge *maxSpeedMetric;
+    Utility::Gauge *densityErrorMetric;
+    Utility::Gauge *maxDensityErrorMetric;
+    Utility::Counter *pressureClampMetric;
+    Utility::Counter *watchdogRollbacksMetric;
+    Utility::Counter *stepsMetric;
+    Utility::Counter *allocationsMetric;
+    Utility::Counter *recordingDroppedMetric;
+    Utility::Counter *streamDroppedMetric;
+
+    // totals at the last update, counters are advanced by the difference
+    uint64_t lastAllocations = 0;
+    int lastRecordingDropped = 0;
+    int lastStreamDropped = 0;
+    int lastWatchdogEvents = 0;
+
+    void createMetrics();
+    void updateMetrics();
 };
\ No newline at end of file
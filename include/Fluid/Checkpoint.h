@@ -0,0 +1,82 @@
+#pragma once
+
+#include "./Fluid.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * Binary checkpoint of a fluid's particles, options and attractors.
+     *
+     * Layout:
+     * - CheckpointHeader
+     * - FluidOptions
+     * - ParticleRecord[numParticles]
+     * - FluidAttractor[numAttractors]
+     *
+     * Every section starts on a 64 byte boundary and is stored exactly as it is in memory (little endian),
+     * so a checkpoint can be memory mapped and read in place after validating the header and checksum.
+     * Checkpoints are only valid for the version and struct sizes they were written with.
+     */
+    namespace Checkpoint
+    {
+        const char MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P'};
+        const uint32_t VERSION = 1;
+        const uint64_t SECTION_ALIGNMENT = 64;
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t headerSize;
+            uint64_t fileSize;
+
+            // checksum of everything after the header
+            uint64_t checksum;
+
+            uint64_t optionsOffset;
+            uint64_t optionsSize;
+
+            uint64_t particlesOffset;
+            uint64_t particleSize;
+            uint64_t numParticles;
+
+            uint64_t attractorsOffset;
+            uint64_t attractorSize;
+            uint64_t numAttractors;
+        };
+
+        // in the fluid's Scalar type, so checkpoints are only valid for builds with the same precision
+        struct ParticleRecord
+        {
+            Vec2 position;
+            Vec2 velocity;
+            Vec2 predictedPosition;
+            float radius;
+            Scalar mass;
+            Scalar density;
+            Scalar pressure;
+        };
+
+        /**
+         * Writes a checkpoint into the buffer, reusing its memory.
+         */
+        void write(std::vector<char> &buffer, const FluidOptions &options, const std::vector<Particle *> &particles, const std::vector<FluidAttractor> &attractors);
+
+        /**
+         * Checks that the data is a complete, uncorrupted checkpoint this build can read.
+         *
+         * @return The checkpoint's header or nullptr if the data isn't valid.
+         */
+        const Header *validate(const char *data, size_t size);
+
+        const FluidOptions *getOptions(const char *data);
+        const ParticleRecord *getParticles(const char *data);
+        const FluidAttractor *getAttractors(const char *data);
+
+        uint64_t checksum(const char *data, size_t size);
+    }
+}
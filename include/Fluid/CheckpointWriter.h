@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * Writes checkpoint data to disk on a background thread.
+     *
+     * The data to write is put into the writer's buffer and then written with start,
+     * the buffer can't be touched again until the write has finished.
+     */
+    class CheckpointWriter
+    {
+    public:
+        CheckpointWriter();
+        ~CheckpointWriter();
+
+        std::vector<char> &getBuffer();
+
+        /**
+         * Starts writing the buffer to the given path.
+         *
+         * The file is written next to the path and then renamed over it, so a crash mid write never leaves a broken checkpoint.
+         *
+         * @return False if a previous write hasn't finished yet.
+         */
+        bool start(const std::string &path);
+
+        bool isWriting();
+        void wait();
+
+    private:
+        void writeThread(std::string path);
+
+        std::vector<char> buffer;
+        std::thread thread;
+        std::atomic<bool> writing = false;
+    };
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "./Scalar.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace Fluid
+{
+    /**
+     * IEEE half precision conversions, rounding to nearest even.
+     */
+    inline uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint16_t sign = (bits >> 16) & 0x8000;
+        uint32_t magnitude = bits & 0x7FFFFFFF;
+
+        // nan and inf, nans stay nans
+        if (magnitude >= 0x7F800000)
+            return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+
+        // 65520 and above round to inf
+        if (magnitude >= 0x477FF000)
+            return sign | 0x7C00;
+
+        // 2^-25 and below round to zero
+        if (magnitude <= 0x33000000)
+            return sign;
+
+        // subnormal halves, the float's mantissa with its implicit 1 is shifted down
+        if (magnitude < 0x38800000)
+        {
+            uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+            int shift = 126 - static_cast<int>(magnitude >> 23);
+
+            uint32_t rounded = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+
+            if (remainder > halfway || (remainder == halfway && (rounded & 1)))
+                rounded++;
+
+            return sign | rounded;
+        }
+
+        // rebias the exponent and round the mantissa, a carry moves into the exponent
+        uint32_t half = magnitude - 0x38000000;
+        half += 0xFFF + ((half >> 13) & 1);
+
+        return sign | (half >> 13);
+    }
+
+    inline float halfToFloat(uint16_t half)
+    {
+        uint32_t sign = (half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1F;
+        uint32_t mantissa = half & 0x3FF;
+
+        // subnormal, mantissa * 2^-24
+        if (exponent == 0)
+        {
+            float value = mantissa * (1.0f / 16777216.0f);
+            return sign ? -value : value;
+        }
+
+        uint32_t bits;
+        if (exponent == 0x1F)
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        else
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /**
+     * A vector stored as two half precision floats. (4 bytes)
+     */
+    struct HalfVec2
+    {
+        uint16_t x = 0;
+        uint16_t y = 0;
+
+        HalfVec2() = default;
+        HalfVec2(const Vec2 &v) : x(floatToHalf(v.x)), y(floatToHalf(v.y)) {}
+
+        operator Vec2() const
+        {
+            return Vec2(halfToFloat(x), halfToFloat(y));
+        }
+    };
+
+    /**
+     * A vector stored as two 16 bit integers sharing an exponent. (6 bytes)
+     *
+     * The larger component always uses the full 16 bit range, so unlike a half there is no
+     * fixed range and no loss of precision for small vectors, only for the smaller component.
+     */
+    struct QuantisedVec2
+    {
+        // exponent for a non finite vector, so blow ups aren't hidden
+        static const int8_t NOT_FINITE = -128;
+
+        int16_t x = 0;
+        int16_t y = 0;
+        int8_t exponent = 0;
+
+        QuantisedVec2() = default;
+        QuantisedVec2(const Vec2 &v)
+        {
+            Scalar largest = std::fmax(std::fabs(v.x), std::fabs(v.y));
+
+            if (!std::isfinite(largest))
+            {
+                exponent = NOT_FINITE;
+                return;
+            }
+
+            if (largest == 0)
+                return;
+
+            // largest is below 2^e, so largest * 2^(15 - e) fits in 16 bits
+            int e;
+            std::frexp(largest, &e);
+            exponent = static_cast<int8_t>(std::fmax(std::fmin(e - 15, 127), -127));
+
+            Scalar scale = std::ldexp(Scalar(1), -exponent);
+            x = static_cast<int16_t>(std::fmax(std::fmin(std::round(v.x * scale), 32767), -32767));
+            y = static_cast<int16_t>(std::fmax(std::fmin(std::round(v.y * scale), 32767), -32767));
+        }
+
+        operator Vec2() const
+        {
+            if (exponent == NOT_FINITE)
+                return Vec2(NAN, NAN);
+
+            Scalar scale = std::ldexp(Scalar(1), exponent);
+            return Vec2(x * scale, y * scale);
+        }
+    };
+
+    /**
+     * How cold particle attributes (the forces, only written and read once a step) are stored.
+     *
+     * Build with -DFLUID_COLD_STORAGE_HALF or -DFLUID_COLD_STORAGE_INT16 to shrink them for runs
+     * limited by memory bandwidth, they are still computed in Scalar.
+     */
+#if defined(FLUID_COLD_STORAGE_HALF)
+    using ColdVec2 = HalfVec2;
+    const char *const COLD_STORAGE_NAME = "half";
+#elif defined(FLUID_COLD_STORAGE_INT16)
+    using ColdVec2 = QuantisedVec2;
+    const char *const COLD_STORAGE_NAME = "int16";
+#else
+    using ColdVec2 = Vec2;
+    const char *const COLD_STORAGE_NAME = SCALAR_NAME;
+#endif
+}
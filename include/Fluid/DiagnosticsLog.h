@@ -0,0 +1,75 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * Physics diagnostics for a single step, gathered while the step is solved.
+     */
+    struct FluidDiagnostics
+    {
+        int step;
+        float dt;
+
+        // at the end of the step
+        double kineticEnergy;
+        // gravitational potential energy relative to the origin
+        double potentialEnergy;
+        float maxSpeed;
+
+        // absolute difference between density and desiredRestDensity, as a fraction of desiredRestDensity
+        float meanDensityError;
+        float maxDensityError;
+
+        // particles whose pressure was clamped to pressureLimit
+        int pressureClampHits;
+    };
+
+    /**
+     * Keeps the diagnostics of the last few steps in a ring buffer and optionally appends every step to a CSV file.
+     */
+    class DiagnosticsLog
+    {
+    public:
+        DiagnosticsLog(int capacity = 600);
+        ~DiagnosticsLog();
+
+        void push(const FluidDiagnostics &diagnostics);
+        void clear();
+
+        int getSize();
+        int getCapacity();
+
+        /**
+         * @param i 0 is the oldest entry, getSize() - 1 the latest.
+         */
+        const FluidDiagnostics &get(int i);
+
+        /**
+         * Starts appending every pushed entry to a CSV file, the file is overwritten.
+         *
+         * @return False if the file couldn't be opened.
+         */
+        bool startCsv(const std::string &path);
+        void stopCsv();
+        bool isWritingCsv();
+
+        /**
+         * Writes the entries currently in the ring buffer to a CSV file.
+         */
+        bool saveCsv(const std::string &path);
+
+    private:
+        void writeCsvHeader(std::ostream &out);
+        void writeCsvRow(std::ostream &out, const FluidDiagnostics &diagnostics);
+
+        std::vector<FluidDiagnostics> entries;
+        int capacity;
+        int start = 0;
+
+        std::ofstream csv;
+    };
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "./Particle.h"
+#include "./AABB.h"
+#include "./ObstacleField.h"
+
+#include <vector>
+
+namespace Fluid
+{
+    enum FlipCellType
+    {
+        FLIP_AIR,
+        FLIP_FLUID,
+        FLIP_SOLID,
+    };
+
+    /**
+     * A FLIP/PIC grid solver.
+     *
+     * Particle velocities are transferred onto a staggered (MAC) grid, made divergence free with a Jacobi preconditioned
+     * conjugate gradient pressure solve and transferred back. The cost is linear in the number of particles and grid cells
+     * rather than in the number of neighbouring pairs, so it scales to far more particles than SPH.
+     *
+     * Horizontal velocities are stored on the left and right faces of cells and vertical velocities on the top and bottom faces.
+     * The edges of the grid and cells inside obstacles are solid.
+     */
+    class FlipSolver
+    {
+    public:
+        /**
+         * Transfers the particles' velocities onto a grid covering the bounds and finds which cells hold fluid.
+         *
+         * @param cellSize Rough size of a cell, cells are stretched so a whole number of them fit in the bounds.
+         * @param particleSpacing Distance between particles at rest, cells holding more particles than that allows are pushed apart.
+         */
+        void transferToGrid(const std::vector<Particle *> &particles, const AABB &bounds, float cellSize, float particleSpacing, ObstacleField *obstacles, const int numThreads = 4);
+
+        /**
+         * Solves for the pressure that makes the grid velocities divergence free and applies it, starting from the last pressure.
+         *
+         * @param tolerance Largest residual the solve stops at, relative to the largest divergence.
+         *
+         * @return The number of iterations taken.
+         */
+        int solvePressure(float dt, float tolerance, int maxIterations, const int numThreads = 4);
+
+        /**
+         * Sets the particle's velocity from the grid, this never modifies the grid so it is safe to call from multiple threads at once.
+         *
+         * @param flipBlend How much of the particle's velocity is kept and changed by the grid (FLIP)
+         * rather than replaced by the grid velocity (PIC), 1 is pure FLIP and 0 is pure PIC.
+         */
+        void transferToParticle(Particle *p, float flipBlend);
+
+        int getWidth();
+        int getHeight();
+        FlipCellType getCellType(int x, int y);
+
+    private:
+        void iterateRowsThreaded(void (FlipSolver::*func)(int, int), int numRows, const int numThreads);
+
+        void sortParticles(const std::vector<Particle *> &particles);
+        void transferToGridUThread(int startingRow, int endingRow);
+        void transferToGridVThread(int startingRow, int endingRow);
+        void classifyCellsThread(int startingRow, int endingRow);
+        void removeEnclosedFluid();
+        void enforceBoundaries();
+
+        /**
+         * Fills faces that aren't valid with the average of their valid neighbours, a layer of faces at a time.
+         */
+        void extrapolate(std::vector<Scalar> &field, std::vector<char> &valid, int fieldWidth, int fieldHeight, int numLayers);
+        void findFluidFaces();
+
+        // pressure solve
+        void startSolveThread(int startingRow, int endingRow);
+        void startDirectionThread(int startingRow, int endingRow);
+        void multiplyThread(int startingRow, int endingRow);
+        void stepThread(int startingRow, int endingRow);
+        void updateDirectionThread(int startingRow, int endingRow);
+        void applyPressureThread(int startingRow, int endingRow);
+        Scalar applyLaplacian(const std::vector<Scalar> &values, int x, int y);
+        Scalar getDiagonal(int x, int y);
+
+        /**
+         * Bilinear (tent) weight of a particle at an offset from a face or cell centre.
+         */
+        Scalar getWeight(const Vec2 &offset);
+
+        Vec2 sampleVelocity(const std::vector<Scalar> &uField, const std::vector<Scalar> &vField, const Vec2 &position);
+        Scalar sampleField(const std::vector<Scalar> &field, int fieldWidth, int fieldHeight, Scalar x, Scalar y);
+
+        bool isSolid(int x, int y);
+        bool isFluid(int x, int y);
+
+        AABB bounds;
+        Scalar cellWidth;
+        Scalar cellHeight;
+        int width = 0;
+        int height = 0;
+        ObstacleField *obstacles = nullptr;
+
+        // particles sorted by cell, the particles in cell i are cellParticles[cellOffsets[i]] to cellParticles[cellOffsets[i + 1]]
+        std::vector<int> cellOffsets;
+        std::vector<Particle *> cellParticles;
+
+        std::vector<FlipCellType> cellTypes;
+
+        // compression of a cell is its particle density above the density at rest,
+        // DRIFT_CORRECTION is the fraction of it removed each step
+        std::vector<Scalar> particleDensities;
+        Scalar restParticlesPerCell;
+        Scalar dt;
+        static constexpr Scalar DRIFT_CORRECTION = 0.5;
+
+        // u is (width + 1) x height and v is width x (height + 1), the old velocities are from before the pressure solve
+        std::vector<Scalar> u;
+        std::vector<Scalar> v;
+        std::vector<Scalar> uOld;
+        std::vector<Scalar> vOld;
+        std::vector<char> uValid;
+        std::vector<char> vValid;
+
+        // conjugate gradient state, one value per cell
+        std::vector<Scalar> pressure;
+        std::vector<Scalar> divergence;
+        std::vector<Scalar> residual;
+        std::vector<Scalar> preconditioned;
+        std::vector<Scalar> direction;
+        std::vector<Scalar> product;
+        Scalar alpha;
+        Scalar beta;
+
+        // reductions are summed per row then in row order, so the result doesn't depend on the number of threads
+        std::vector<double> rowDots;
+        std::vector<double> rowMaxes;
+        double sumRows(const std::vector<double> &rows);
+        double maxRows(const std::vector<double> &rows);
+    };
+}
@@ -2,6 +2,13 @@
 
 #include "./Particle.h"
 #include "./AABB.h"
+#include "./SpatialHash.h"
+#include "./ObstacleField.h"
+#include "./CheckpointWriter.h"
+#include "./SharedFramePublisher.h"
+#include "./DiagnosticsLog.h"
+#include "./Watchdog.h"
+#include "./FlipSolver.h"
 #include "./SmoothingKernel/SmoothingKernelPoly6.h"
 #include "./SmoothingKernel/SmoothingKernelSpiky.h"
 
@@ -9,9 +16,37 @@
 #include <unordered_map>
 #include <boost/functional/hash.hpp>
 #include <functional>
+#include <string>
 
 namespace Fluid
 {
+    enum GridType
+    {
+        // every cell inside the bounding box is preallocated
+        DENSE_GRID,
+
+        // only occupied cells are stored, works for huge domains and without a bounding box
+        SPARSE_GRID,
+    };
+
+    enum SolverType
+    {
+        // pressure from an equation of state, weakly compressible so needs a large stiffness and small steps
+        SPH_SOLVER,
+
+        // predictive-corrective incompressible SPH, pressure is iterated until the predicted compression is below solverTolerance,
+        // desiredRestDensity should be the density of the fluid at rest since it isn't compressed past it
+        PCISPH_SOLVER,
+
+        // position based fluids, predicted positions are moved until they satisfy the density constraints,
+        // stable at any step size but less accurate, desiredRestDensity is treated the same as for pcisph
+        PBF_SOLVER,
+
+        // flip/pic, velocities are made divergence free on a grid of flipCellSize cells covering the bounding box,
+        // scales to many more particles but needs a bounding box and ignores viscosity and surface tension
+        FLIP_SOLVER,
+    };
+
     struct FluidOptions
     {
         int numParticles;
@@ -21,9 +56,17 @@ namespace Fluid
 
         glm::vec2 gravity;
 
+        bool useBoundingBox;
         AABB boundingBox;
         float boudingBoxRestitution;
 
+        // wrap particles around the bounding box instead of colliding with it,
+        // periodic axes should be at least 3 smoothing radii long
+        bool periodicX;
+        bool periodicY;
+
+        float obstacleRestitution;
+
         float pressureLimit;
         float smoothingRadius;
         float stiffness;
@@ -35,6 +78,72 @@ namespace Fluid
 
         bool usePredictedPositions;
         int numThreads;
+
+        // only move particles whose grid cell changed instead of rebuilding the grid every step,
+        // falls back to a full rebuild when more than gridRebuildThreshold (0 to 1) of the particles move
+        bool useIncrementalGrid;
+        float gridRebuildThreshold;
+
+        // a sparse grid is always used when there is no bounding box
+        GridType gridType;
+
+        SolverType solver;
+
+        // average compression (relative to desiredRestDensity) the iterative solvers stop at,
+        // they always run at least solverMinIterations and never more than solverMaxIterations,
+        // the flip solver instead stops once the largest divergence left is solverTolerance of the largest it started with
+        float solverTolerance;
+        int solverMinIterations;
+        int solverMaxIterations;
+
+        // strength of the artificial pressure that stops pbf particles clumping, 0.1 is typical and 0 disables it
+        float artificialPressure;
+
+        // size of the flip solver's grid cells, about two particle spacings,
+        // and how much of the particles' own velocity change is kept (1 is pure flip, 0 is pure pic)
+        float flipCellSize;
+        float flipBlend;
+
+        // solve viscosity implicitly over the neighbours instead of applying it as a force, so high viscosities
+        // (honey, mud, lava) are stable at the same step size as water, ignored by the flip solver,
+        // the solve stops once the residual is viscosityTolerance of the residual of the last step's velocities
+        bool implicitViscosity;
+        float viscosityTolerance;
+        int viscosityMaxIterations;
+    };
+
+    enum FluidPhase
+    {
+        PHASE_PRE_SOLVE,
+        PHASE_GRID,
+        PHASE_NEIGHBOURS,
+        PHASE_DENSITY_PRESSURE,
+        PHASE_FORCES,
+        PHASE_VISCOSITY_SOLVE,
+        PHASE_PRESSURE_SOLVE,
+        PHASE_APPLY_FORCES,
+        NUM_PHASES
+    };
+
+    struct FluidStats
+    {
+        // how long each phase of the last update took
+        float phaseSeconds[NUM_PHASES];
+
+        // number of particles that changed grid cell during the last update
+        int gridMoves;
+
+        // fraction of particles that changed grid cell during the last update
+        float gridChurn;
+
+        // true if the grid was fully rebuilt during the last update
+        bool gridRebuilt;
+
+        // iterations the pressure solver took during the last update, 0 for the SPH solver
+        int solverIterations;
+
+        // iterations the implicit viscosity solve took during the last update, 0 if viscosity is explicit
+        int viscosityIterations;
     };
 
     struct FluidAttractor
@@ -44,6 +153,14 @@ namespace Fluid
         float strength;
     };
 
+    struct FluidAttractorHandle
+    {
+        int slot = -1;
+
+        // incremented when a slot is reused so old handles stop working
+        int generation = 0;
+    };
+
     using Grid = std::unordered_map<std::pair<int, int>, std::vector<Particle *>, boost::hash<std::pair<int, int>>>;
 
     class Fluid
@@ -58,14 +175,106 @@ namespace Fluid
         std::vector<Particle *> &getParticles();
         void clearParticles();
 
-        void addAttractor(FluidAttractor *attractor);
-        bool removeAttractor(FluidAttractor *attractor);
+        FluidAttractorHandle addAttractor(const FluidAttractor &attractor);
+        bool removeAttractor(FluidAttractorHandle handle);
         void clearAttractors();
 
+        /**
+         * Gets an attractor so it can be moved or changed.
+         *
+         * @return The attractor or nullptr if the handle has been removed. (invalidated when attractors are added or removed)
+         */
+        FluidAttractor *getAttractor(FluidAttractorHandle handle);
+        int getNumAttractors();
+
+        /**
+         * Sets the static obstacles particles collide with, the field must be baked.
+         *
+         * @param obstacles The obstacles or nullptr to remove obstacles. (not owned by the fluid)
+         */
+        void setObstacles(ObstacleField *obstacles);
+
+        FluidOptions &getOptions();
+
+        /**
+         * Saves the fluid's particles, options and attractors to a checkpoint file.
+         *
+         * The state is copied before returning and the file is written on a background thread,
+         * so the fluid can keep being updated while it saves.
+         *
+         * @return False if the last checkpoint is still being written.
+         */
+        bool saveCheckpoint(const std::string &path);
+        bool isSavingCheckpoint();
+
+        /**
+         * Restores the fluid's particles, options and attractors from a checkpoint file.
+         *
+         * Attractor handles from before loading are no longer valid.
+         *
+         * @return False if the file couldn't be read or isn't a valid checkpoint, the fluid is unchanged in this case.
+         */
+        bool loadCheckpoint(const std::string &path);
+
+        /**
+         * Publishes the particles into shared memory after every update, see SharedFrameReader for reading them from another process.
+         *
+         * @param maxParticles The most particles a frame can hold, defaults to options.numParticles.
+         *
+         * @return False if the shared memory couldn't be created.
+         */
+        bool startPublishing(const std::string &name, int maxParticles = -1);
+        void stopPublishing();
+        bool isPublishing();
+
         Grid &getGrid();
+        SpatialHash &getSpatialHash();
+
+        /**
+         * Calls func for every cell in the grid currently being used.
+         */
+        void forEachGridCell(const std::function<void(const std::pair<int, int> &, const std::vector<Particle *> &)> &func);
+        bool isGridSparse();
+        glm::vec2 getCellSize();
+
+        const FluidStats &getStats();
+
+        /**
+         * Diagnostics of the last update, they are reduced from the solver's own passes so cost next to nothing.
+         */
+        const FluidDiagnostics &getDiagnostics();
+
+        /**
+         * Every update's diagnostics are pushed into this log.
+         */
+        DiagnosticsLog &getDiagnosticsLog();
+
+        /**
+         * Checks every update for blow ups and rolls the particles back to a recent snapshot with a smaller dt when one happens.
+         */
+        void enableWatchdog(const WatchdogOptions &watchdogOptions = WatchdogOptions());
+        void disableWatchdog();
+
+        /**
+         * @return The watchdog or nullptr if it isn't enabled.
+         */
+        Watchdog *getWatchdog();
+
+        /**
+         * Gets the region each thread works on during the neighbour search, for debugging.
+         *
+         * For the dense grid these are the column sections of the grid, otherwise the bounds of each thread's range of particles.
+         */
+        void getThreadPartitions(std::vector<AABB> &partitions);
 
         float solveDensityAtPoint(const glm::vec2 &point);
 
+        /**
+         * Hashes the particles' positions, velocities, densities and pressures bit for bit,
+         * two runs with the same hash after the same steps are identical.
+         */
+        uint64_t getStateHash();
+
     private:
         void solveDensityPressure(Particle *p);
         void solvePressureForce(Particle *p);
@@ -73,17 +282,57 @@ namespace Fluid
         void solveViscosityForce(Particle *p);
         void solveTensionForce(Particle *p);
 
-        void applyGravity(Particle *p, float dt);
-        void applySPHForces(Particle *p, float dt);
-        void applyAttractors(Particle *p, float dt);
-        void applyVelocity(Particle *p, float dt);
+        void applyGravity(Particle *p, Scalar dt);
+        void applySPHForces(Particle *p, Scalar dt);
+        void applyAttractors(Particle *p, Scalar dt);
+        void binAttractors();
+        void applyVelocity(Particle *p, Scalar dt);
+
+        // pcisph
+        void solvePcisph();
+        void applyNonPressureForcesThread(int startingParticle, int endingParticle, int threadIndex);
+        void predictPcisphDensityThread(int startingParticle, int endingParticle, int threadIndex);
+        void solvePcisphPressureThread(int startingParticle, int endingParticle, int threadIndex);
+        // pbf
+        void solvePbf();
+        void solvePbfConstraintThread(int startingParticle, int endingParticle, int threadIndex);
+        void solvePbfCorrectionThread(int startingParticle, int endingParticle, int threadIndex);
+        void applyPbfCorrectionThread(int startingParticle, int endingParticle, int threadIndex);
+        // implicit viscosity
+        void solveImplicitViscosity();
+        void startViscosityThread(int startingParticle, int endingParticle, int threadIndex);
+        void multiplyViscosityThread(int startingParticle, int endingParticle, int threadIndex);
+        void stepViscosityThread(int startingParticle, int endingParticle, int threadIndex);
+        void updateViscosityDirectionThread(int startingParticle, int endingParticle, int threadIndex);
+        void applyViscosityThread(int startingParticle, int endingParticle, int threadIndex);
+
+        /**
+         * Applies density + dt * viscosity * the viscosity laplacian to the particle's value, the laplacian is symmetric
+         * since every pair of neighbours weights each other the same.
+         */
+        Vec2 applyViscosityOperator(int i, const std::vector<Vec2> &values);
+
+        void clampPrediction(Particle *p);
+        Scalar getPcisphPressureScale();
+
+        /**
+         * Gets |sum of grad W|^2 + sum of |grad W|^2 over a particle with a full neighbourhood on the lattice the fluid starts on,
+         * which is how strongly density responds to moving particles.
+         */
+        Scalar getPrototypeGradientSqr();
 
         void applyBoundingBox(Particle *p);
+        void applyObstacles(Particle *p);
 
         void iterateGridCellsThreaded(void (Fluid::*func)(glm::vec2, glm::vec2, int), const int numThreads = 4);
         void findNeighboursThread(glm::vec2 startingCell, glm::vec2 endingCell, int threadIndex);
+        void findNeighboursParticlesThread(int startingParticle, int endingParticle, int threadIndex);
 
         void iterateParticlesThreaded(void (Fluid::*func)(int, int, int), const int numThreads = 4);
+
+        // threads are given whole chunks of particles
+        static const int PARTICLE_CHUNK_SIZE = 64;
+        int getParticlesPerThread(const int numThreads);
         void solveDensityPressureThread(int startingParticle, int endingParticle, int threadIndex);
         void solveForcesThread(int startingParticle, int endingParticle, int threadIndex);
         void applyForcesThread(int startingParticle, int endingParticle, int threadIndex);
@@ -91,22 +340,134 @@ namespace Fluid
         std::vector<ParticleNeighbour> getParticlesOfInfluence(Particle *p, bool usePredictedPositions = false);
 
         void updateGrid(bool usePredictedPositions = false);
+        void rebuildGrid(bool usePredictedPositions = false);
         glm::vec2 getGridDimensions();
+        void getGridSections(const int numThreads, int start[], int end[]);
+        int getNeighbourCells(int cell, bool periodic, int numCells, int cells[3]);
+
+        /**
+         * Gets the vector from b to a, using the closest periodic image of b.
+         */
+        Vec2 getSeparation(const Vec2 &a, const Vec2 &b);
+        Scalar wrap(Scalar value, Scalar size);
 
         void insertIntoGrid(Particle *p, bool usePredictedPositions = false);
+        void removeFromGrid(Particle *p);
+        std::vector<Particle *> &getGridCell(const std::pair<int, int> &key);
+        std::vector<Particle *> *findGridCell(const std::pair<int, int> &key);
         std::pair<int, int> getGridKey(Particle *p, bool usePredictedPositions = false);
 
-        glm::vec2 randomDirection();
+        /**
+         * A random direction for a pair of particles at the same position.
+         */
+        Vec2 randomDirection(Particle *p, Particle *q);
 
         FluidOptions options;
         std::vector<Particle *> particles;
-        std::vector<FluidAttractor *> attractors;
+        // attractors are stored contiguously, slots map handles to their index in attractors
+        std::vector<FluidAttractor> attractors;
+        std::vector<int> attractorSlots;
+        std::vector<int> attractorSlotGenerations;
+        std::vector<int> attractorSlotOfIndex;
+        std::vector<int> freeAttractorSlots;
+
+        // attractors binned into a coarse grid by the cells their radius overlaps,
+        // the attractors in bin i are attractorBinEntries[attractorBinOffsets[i]] to attractorBinEntries[attractorBinOffsets[i + 1]]
+        glm::vec2 attractorBinOrigin;
+        float attractorBinSize;
+        int attractorBinsX = 0;
+        int attractorBinsY = 0;
+        std::vector<int> attractorBinOffsets;
+        std::vector<int> attractorBinEntries;
+        ObstacleField *obstacles = nullptr;
+
+        CheckpointWriter checkpointWriter;
+        SharedFramePublisher publisher;
 
         Grid grid;
+        SpatialHash spatialHash;
+        bool gridValid = false;
+        bool gridWasSparse = false;
+        std::vector<Particle *> gridMovers;
+
+        FluidStats stats{};
+
+        // diagnostics are reduced into a partial per chunk of particles and the partials are summed in order,
+        // so the totals don't depend on the number of threads, partials are padded so threads don't share cache lines
+        struct alignas(64) DiagnosticsPartial
+        {
+            double densityError;
+            float maxDensityError;
+            int pressureClampHits;
+            double kineticEnergy;
+            double potentialEnergy;
+            float maxSpeedSqr;
+
+            // predicted density above rest density, the pcisph solver stops once its average is small enough
+            double compression;
+        };
+
+        std::vector<DiagnosticsPartial> diagnosticsPartials;
+        FluidDiagnostics diagnostics{};
+        DiagnosticsLog diagnosticsLog;
+        int step = 0;
+        void reduceDiagnostics();
+
+        // pressure acceleration of each particle and the scale from density error to pressure during the pcisph solve
+        std::vector<Vec2> pcisphAccelerations;
+        Scalar pcisphPressureScale;
+        static constexpr Scalar PCISPH_RELAXATION = 0.5;
+
+        // position correction of each particle during the pbf solve, the constraint multipliers are kept in the particles' pressure
+        std::vector<Vec2> pbfCorrections;
+        Scalar pbfRelaxation;
+
+        // fraction of the prototype's gradient that softens the pbf constraints, so particles with few neighbours aren't thrown
+        static constexpr Scalar PBF_SOFTENING = 0.05;
+
+        // every particle in a neighbourhood corrects the same compression at once, so only part of each correction is applied
+        static constexpr Scalar PBF_RELAXATION = 0.25;
+
+        FlipSolver flipSolver;
+
+        // implicit viscosity solves density * v - dt * viscosity * laplacian(v) = density * v*, where v* is the velocity every other force gives,
+        // by conjugate gradient on both axes at once, the result is stored as the viscosity force so every solver applies it the same way
+        std::vector<Vec2> viscosityTargets;
+        std::vector<Vec2> viscositySolution;
+        std::vector<Vec2> viscosityResidual;
+        std::vector<Vec2> viscosityPreconditioned;
+        std::vector<Vec2> viscosityDirection;
+        std::vector<Vec2> viscosityProduct;
+        std::vector<Scalar> viscosityDiagonals;
+        Vec2 viscosityAlpha;
+        Vec2 viscosityBeta;
+
+        // reduced per chunk like the diagnostics so the solve doesn't depend on the number of threads
+        struct alignas(64) ViscosityPartial
+        {
+            double dotX;
+            double dotY;
+            double residualSqr;
+        };
+
+        std::vector<ViscosityPartial> viscosityPartials;
+
+        /**
+         * Sums the partials in chunk order and clears them for the next pass.
+         */
+        ViscosityPartial takeViscosityPartials();
+
+        Watchdog *watchdog = nullptr;
+        void watch();
+
+        /**
+         * Copies the particles out of validated checkpoint data.
+         */
+        void restoreParticles(const char *data, uint64_t numParticles);
 
         SmoothingKernelPoly6 smoothingKernelPoly6;
         SmoothingKernelSpiky smoothingKernelSpiky;
 
-        float dt;
+        Scalar dt;
     };
 }
\ No newline at end of file
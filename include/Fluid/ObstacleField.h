@@ -0,0 +1,77 @@
+#pragma once
+
+#include "./AABB.h"
+
+#include <glm/vec2.hpp>
+#include <vector>
+
+namespace Fluid
+{
+    struct ObstacleCircle
+    {
+        glm::vec2 centre;
+        float radius;
+    };
+
+    struct ObstacleSample
+    {
+        // signed distance to the closest obstacle surface, negative inside an obstacle
+        float distance;
+
+        // points away from the closest obstacle surface
+        glm::vec2 normal;
+    };
+
+    /**
+     * Static obstacles baked into a signed distance field.
+     *
+     * Shapes are added and then baked into a grid of distances and normals covering the given bounds,
+     * after that any point can be tested against every obstacle with a single bilinear lookup,
+     * so the cost of a collision test doesn't depend on how many shapes there are or how complex they are.
+     *
+     * Points outside of the bounds are treated as being outside of all obstacles.
+     */
+    class ObstacleField
+    {
+    public:
+        ObstacleField(AABB bounds, float cellSize);
+
+        void addCircle(const ObstacleCircle &circle);
+
+        /**
+         * Adds a polygon obstacle.
+         *
+         * @param vertices The vertices of the polygon. (must be in clockwise order, like Renderer::polygon)
+         */
+        void addPolygon(const std::vector<glm::vec2> &vertices);
+
+        void clear();
+
+        /**
+         * Bakes the added shapes into the distance field, must be called after adding shapes and before sampling.
+         */
+        void bake(const int numThreads = 4);
+        bool isBaked();
+
+        ObstacleSample sample(const glm::vec2 &position);
+
+        const std::vector<ObstacleCircle> &getCircles();
+        const std::vector<std::vector<glm::vec2>> &getPolygons();
+
+    private:
+        void bakeThread(int startingRow, int endingRow);
+        float solveShapesDistance(const glm::vec2 &point);
+
+        AABB bounds;
+        float cellSize;
+        int width;
+        int height;
+
+        std::vector<ObstacleCircle> circles;
+        std::vector<std::vector<glm::vec2>> polygons;
+
+        bool baked = false;
+        std::vector<float> distances;
+        std::vector<glm::vec2> normals;
+    };
+}
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <glm/vec2.hpp>
+#include "./Scalar.h"
+#include "./CompactVec2.h"
+
 #include <utility>
 #include <vector>
 
@@ -10,8 +12,8 @@ namespace Fluid
 
     struct ParticleDistance
     {
-        float distance;
-        glm::vec2 direction;
+        Scalar distance;
+        Vec2 direction;
     };
 
     struct ParticleNeighbour
@@ -22,23 +24,32 @@ namespace Fluid
 
     struct Particle
     {
-        glm::vec2 position;
-        glm::vec2 velocity;
+        // index of the particle when it was created, keys its random numbers
+        int id = 0;
+
+        Vec2 position;
+        Vec2 velocity;
         float radius;
-        float mass;
+        Scalar mass;
+
+        Scalar density;
+        Scalar pressure;
 
-        float density;
-        float pressure;
-        glm::vec2 pressureForce;
-        glm::vec2 pressureNearForce;
-        glm::vec2 viscosityForce;
-        glm::vec2 tensionForce;
-        glm::vec2 predictedPosition;
+        // only written and read once a step, so kept in the possibly smaller cold storage
+        ColdVec2 pressureForce;
+        ColdVec2 pressureNearForce;
+        ColdVec2 viscosityForce;
+        ColdVec2 tensionForce;
+
+        Vec2 predictedPosition;
 
         // cached neighbours
         std::vector<ParticleNeighbour> neighbours;
 
         // cached grid key
         std::pair<int, int> gridKey = std::make_pair(-1, -1);
+
+        // index of the particle in its grid cell
+        int gridIndex = -1;
     };
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+
+namespace Fluid
+{
+    /**
+     * The type the solver computes in and keeps hot particle state (positions, velocities, densities) in.
+     *
+     * Build with -DFLUID_DOUBLE_PRECISION for long validation runs, options and everything outside
+     * of the fluid stay in float.
+     */
+#ifdef FLUID_DOUBLE_PRECISION
+    using Scalar = double;
+    using Vec2 = glm::dvec2;
+    const char SCALAR_NAME[] = "double";
+#else
+    using Scalar = float;
+    using Vec2 = glm::vec2;
+    const char SCALAR_NAME[] = "float";
+#endif
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Fluid
+{
+    /**
+     * Layout of the shared memory particle frames written by SharedFramePublisher.
+     *
+     * Layout:
+     * - Header
+     * - numSlots slots, each a SlotHeader followed by one float array per Array value, maxParticles long
+     *
+     * Every part starts on a 64 byte boundary.
+     * Frames are written to the slots in turn, each slot is protected by a seqlock:
+     * its sequence is odd while it is being written, so a reader that sees the same even sequence before and after reading got a whole frame.
+     */
+    namespace SharedFrame
+    {
+        const uint32_t MAGIC = 0x46444C46; // "FLDF"
+        const uint32_t VERSION = 1;
+        const size_t ALIGNMENT = 64;
+
+        enum Array
+        {
+            POSITION_X,
+            POSITION_Y,
+            VELOCITY_X,
+            VELOCITY_Y,
+            DENSITY,
+            NUM_ARRAYS
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t numSlots;
+            uint32_t maxParticles;
+            uint64_t slotSize;
+            uint64_t arrayStride;
+
+            // number of the newest complete frame, frames are numbered from 1 so 0 means nothing has been published
+            std::atomic<uint64_t> latestFrame;
+        };
+
+        struct SlotHeader
+        {
+            std::atomic<uint32_t> sequence;
+            uint32_t numParticles;
+            uint64_t frame;
+            float dt;
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                      "shared frame atomics must be lock free to work across processes");
+
+        inline size_t align(size_t size)
+        {
+            return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        inline size_t getArrayStride(uint32_t maxParticles)
+        {
+            return align(maxParticles * sizeof(float));
+        }
+
+        inline size_t getSlotSize(uint32_t maxParticles)
+        {
+            return align(sizeof(SlotHeader)) + NUM_ARRAYS * getArrayStride(maxParticles);
+        }
+
+        inline size_t getSize(uint32_t numSlots, uint32_t maxParticles)
+        {
+            return align(sizeof(Header)) + numSlots * getSlotSize(maxParticles);
+        }
+
+        inline SlotHeader *getSlot(Header *header, uint64_t frame)
+        {
+            char *slots = reinterpret_cast<char *>(header) + align(sizeof(Header));
+            return reinterpret_cast<SlotHeader *>(slots + (frame % header->numSlots) * header->slotSize);
+        }
+
+        inline float *getArray(Header *header, SlotHeader *slot, Array array)
+        {
+            return reinterpret_cast<float *>(reinterpret_cast<char *>(slot) + align(sizeof(SlotHeader)) + array * header->arrayStride);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "./Particle.h"
+#include "./SharedFrame.h"
+#include "../Utility/SharedMemory.h"
+
+#include <string>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * Publishes particle frames into shared memory for other processes to read with SharedFrameReader.
+     *
+     * Publishing never waits on readers, a reader that is too slow just sees a newer frame or retries.
+     */
+    class SharedFramePublisher
+    {
+    public:
+        /**
+         * Creates the shared memory.
+         *
+         * @param maxParticles Frames with more particles than this only publish the first maxParticles.
+         * @param numSlots How many frames are kept, readers have numSlots - 1 frames to read a frame before it is overwritten.
+         *
+         * @return False if the shared memory couldn't be created.
+         */
+        bool open(const std::string &name, int maxParticles, int numSlots = 3);
+        void close();
+        bool isOpen();
+
+        void publish(const std::vector<Particle *> &particles, float dt);
+
+    private:
+        Utility::SharedMemory memory;
+        SharedFrame::Header *header = nullptr;
+        uint64_t frame = 0;
+    };
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "./SharedFrame.h"
+#include "../Utility/SharedMemory.h"
+
+#include <string>
+
+namespace Fluid
+{
+    struct SharedFrameView
+    {
+        uint64_t frame;
+        int numParticles;
+        float dt;
+
+        // point straight into shared memory
+        const float *positionX;
+        const float *positionY;
+        const float *velocityX;
+        const float *velocityY;
+        const float *density;
+
+        // sequence of the slot when the frame was read
+        const SharedFrame::SlotHeader *slot;
+        uint32_t sequence;
+    };
+
+    /**
+     * Reads particle frames published by SharedFramePublisher in another process.
+     *
+     * Frames are read in place without copying, since the publisher never waits for readers
+     * a frame can be overwritten while it is being read, so check isValid after using a frame's arrays.
+     */
+    class SharedFrameReader
+    {
+    public:
+        /**
+         * @return False if the shared memory doesn't exist or wasn't written by a compatible publisher.
+         */
+        bool open(const std::string &name);
+        void close();
+
+        /**
+         * Gets the newest complete frame.
+         *
+         * @return False if nothing has been published yet.
+         */
+        bool getLatest(SharedFrameView &view);
+
+        /**
+         * @return True if the frame hasn't been overwritten since it was read with getLatest.
+         */
+        bool isValid(const SharedFrameView &view);
+
+    private:
+        Utility::SharedMemory memory;
+        SharedFrame::Header *header = nullptr;
+    };
+}
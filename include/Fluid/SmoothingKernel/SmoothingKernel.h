@@ -7,8 +7,8 @@ namespace Fluid
     class SmoothingKernel
     {
     public:
-        virtual float calculate(ParticleDistance *distance, float smoothingRadius) = 0;
-        virtual float calculateGradient(ParticleDistance *distance, float smoothingRadius) = 0;
-        virtual float calculateLaplacian(ParticleDistance *distance, float smoothingRadius) = 0;
+        virtual Scalar calculate(ParticleDistance *distance, Scalar smoothingRadius) = 0;
+        virtual Scalar calculateGradient(ParticleDistance *distance, Scalar smoothingRadius) = 0;
+        virtual Scalar calculateLaplacian(ParticleDistance *distance, Scalar smoothingRadius) = 0;
     };
 }
\ No newline at end of file
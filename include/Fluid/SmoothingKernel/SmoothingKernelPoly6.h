@@ -7,8 +7,8 @@ namespace Fluid
     class SmoothingKernelPoly6 : public SmoothingKernel
     {
     public:
-        float calculate(ParticleDistance *distance, float smoothingRadius);
-        float calculateGradient(ParticleDistance *distance, float smoothingRadius);
-        float calculateLaplacian(ParticleDistance *distance, float smoothingRadius);
+        Scalar calculate(ParticleDistance *distance, Scalar smoothingRadius);
+        Scalar calculateGradient(ParticleDistance *distance, Scalar smoothingRadius);
+        Scalar calculateLaplacian(ParticleDistance *distance, Scalar smoothingRadius);
     };
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "./Particle.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * A sparse grid of particles.
+     *
+     * Maps grid cell keys to the particles inside that cell using open addressing with linear probing.
+     * Cell keys are packed into 64 bits so any cell coordinate can be stored, including negative
+     * ones and ones outside of the fluid's bounding box. Only occupied cells are stored and the table
+     * is sized to the number of occupied cells, so memory use doesn't depend on the size of the domain.
+     */
+    class SpatialHash
+    {
+    public:
+        using Cell = std::vector<Particle *>;
+
+        /**
+         * Removes all cells.
+         *
+         * The table is resized to fit the number of cells that were occupied before clearing,
+         * memory for the cells themselves is kept so refilling the hash doesn't allocate.
+         */
+        void clear();
+
+        /**
+         * Gets the cell with the given key, creating it if it doesn't exist.
+         */
+        Cell &getCell(const std::pair<int, int> &key);
+
+        /**
+         * Finds the cell with the given key.
+         *
+         * This never modifies the hash so it is safe to call from multiple threads at once.
+         *
+         * @return The cell or nullptr if there is no cell with the given key.
+         */
+        Cell *findCell(const std::pair<int, int> &key);
+
+        int getNumCells();
+        std::pair<int, int> getCellKey(int index);
+        Cell &getCellAt(int index);
+
+    private:
+        static uint64_t packKey(const std::pair<int, int> &key);
+        static uint64_t hashKey(uint64_t key);
+
+        void rehash(int capacity);
+
+        // table slots, a slot is empty when its cell index is -1
+        std::vector<uint64_t> slotKeys;
+        std::vector<int> slotCells;
+
+        // occupied cells, cells past numCells are kept around for reuse
+        std::vector<std::pair<int, int>> cellKeys;
+        std::vector<Cell> cells;
+        int numCells = 0;
+    };
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "./AABB.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * Trajectory file format, written by TrajectoryRecorder and read by TrajectoryReader.
+     *
+     * Layout:
+     * - FileHeader
+     * - chunks
+     * - ChunkIndexEntry[numChunks]
+     * - FileFooter
+     *
+     * Positions are quantised to 16 bits relative to the recording bounds and velocities
+     * to 16 bits in the range -velocityRange to velocityRange. Frames are grouped into chunks,
+     * the first frame of a chunk is stored as is and later frames store the difference from the frame before.
+     * Every value is zigzag and varint encoded, so small differences take a single byte.
+     *
+     * Each frame in a chunk is stored as its step (varint), then the quantised
+     * x positions, y positions, x velocities and y velocities of every particle.
+     *
+     * The chunk index at the end of the file lets any frame be found by decoding at most one chunk.
+     */
+    namespace Trajectory
+    {
+        const char MAGIC[8] = {'F', 'L', 'U', 'I', 'D', 'T', 'R', 'J'};
+        const uint32_t VERSION = 1;
+
+        // x position, y position, x velocity, y velocity
+        const int NUM_CHANNELS = 4;
+
+        struct FileHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t frameInterval;
+            AABB bounds;
+            float velocityRange;
+        };
+
+        struct ChunkIndexEntry
+        {
+            uint64_t offset;
+            uint64_t size;
+            uint64_t firstFrame;
+            uint32_t numFrames;
+            uint32_t numParticles;
+        };
+
+        struct FileFooter
+        {
+            uint64_t indexOffset;
+            uint64_t numChunks;
+            char magic[8];
+        };
+
+        uint16_t quantise(float value, float min, float max);
+        float dequantise(uint16_t value, float min, float max);
+
+        void writeVarint(std::vector<uint8_t> &out, uint64_t value);
+
+        /**
+         * Reads a varint, advancing data.
+         *
+         * @return False if the varint runs past end or doesn't fit in value.
+         */
+        bool readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value);
+        bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value);
+
+        /**
+         * Appends the channels of a frame to out as zigzag varints of the difference from previous.
+         *
+         * @param previous The previous frame's values or nullptr to store the frame as is.
+         */
+        void encodeDeltas(std::vector<uint8_t> &out, const uint16_t *values, const uint16_t *previous, size_t count);
+
+        /**
+         * Decodes count values written by encodeDeltas into values, advancing data.
+         *
+         * @return False if the data runs past end.
+         */
+        bool decodeDeltas(const uint8_t *&data, const uint8_t *end, uint16_t *values, const uint16_t *previous, size_t count);
+    }
+}
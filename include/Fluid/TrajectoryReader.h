@@ -0,0 +1,63 @@
+#pragma once
+
+#include "./Trajectory.h"
+#include "../Utility/MappedFile.h"
+
+#include <glm/vec2.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Fluid
+{
+    struct TrajectoryFrame
+    {
+        // step the frame was recorded at
+        uint64_t step;
+
+        std::vector<glm::vec2> positions;
+        std::vector<glm::vec2> velocities;
+    };
+
+    /**
+     * Reads frames from a trajectory file written by TrajectoryRecorder.
+     *
+     * Any frame can be read in any order, reading frames in order only decodes each frame once.
+     */
+    class TrajectoryReader
+    {
+    public:
+        /**
+         * @return False if the file couldn't be read or isn't a complete trajectory file.
+         */
+        bool open(const std::string &path);
+        void close();
+
+        int getNumFrames();
+        int getFrameInterval();
+        AABB getBounds();
+
+        /**
+         * Reads a frame.
+         *
+         * @return False if the frame doesn't exist or the file is corrupt.
+         */
+        bool readFrame(int frame, TrajectoryFrame &out);
+
+    private:
+        bool decodeNextFrame();
+
+        Utility::MappedFile file;
+        Trajectory::FileHeader header;
+        std::vector<Trajectory::ChunkIndexEntry> chunkIndex;
+        int numFrames = 0;
+
+        // decoding position, so reading the next frame continues from the last one
+        int currentChunk = -1;
+        int currentFrameInChunk = -1;
+        uint64_t currentStep;
+        const uint8_t *currentData;
+        std::vector<uint16_t> quantised;
+        std::vector<uint16_t> previousQuantised;
+    };
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "./Particle.h"
+#include "./Trajectory.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Fluid
+{
+    /**
+     * Records particle positions and velocities to a trajectory file.
+     *
+     * record copies the particles into one of a small pool of frame buffers and returns,
+     * encoding and writing happens on a background thread so recording never waits on the disk.
+     * If every buffer is still waiting to be written the frame is dropped instead.
+     */
+    class TrajectoryRecorder
+    {
+    public:
+        /**
+         * @param path The file to record to.
+         * @param bounds Positions are stored relative to these bounds, positions outside of them are clamped.
+         * @param velocityRange Velocities are clamped to -velocityRange to velocityRange.
+         * @param frameInterval Only every frameInterval-th step is recorded.
+         * @param framesPerChunk Number of frames between frames that are stored in full.
+         */
+        TrajectoryRecorder(const std::string &path, AABB bounds, float velocityRange, int frameInterval = 1, int framesPerChunk = 32);
+        ~TrajectoryRecorder();
+
+        /**
+         * Opens the file and starts the writer thread.
+         *
+         * @return False if the file couldn't be opened.
+         */
+        bool open();
+
+        /**
+         * Finishes writing queued frames and the chunk index, then closes the file.
+         */
+        void close();
+
+        /**
+         * Records the particles, should be called once at the end of every step.
+         */
+        void record(const std::vector<Particle *> &particles);
+
+        int getRecordedFrames();
+        int getDroppedFrames();
+
+    private:
+        struct FrameBuffer
+        {
+            uint64_t step;
+            int numParticles;
+            std::vector<float> positionsX;
+            std::vector<float> positionsY;
+            std::vector<float> velocitiesX;
+            std::vector<float> velocitiesY;
+        };
+
+        void writeThread();
+        void writeFrame(FrameBuffer &frame);
+        void flushChunk();
+
+        std::string path;
+        Trajectory::FileHeader header;
+        int framesPerChunk;
+
+        uint64_t step = 0;
+        int recordedFrames = 0;
+        int droppedFrames = 0;
+
+        // frame buffers shared with the writer thread
+        static const int POOL_SIZE = 4;
+        FrameBuffer pool[POOL_SIZE];
+        std::vector<int> freeFrames;
+        std::deque<int> queuedFrames;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::thread writer;
+        bool closing = false;
+        bool isOpen = false;
+
+        // only used by the writer thread
+        std::ofstream file;
+        uint64_t framesWritten = 0;
+        std::vector<uint16_t> quantised;
+        std::vector<uint16_t> previousQuantised;
+        std::vector<uint8_t> chunkData;
+        Trajectory::ChunkIndexEntry chunk;
+        std::vector<Trajectory::ChunkIndexEntry> chunkIndex;
+    };
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "./Particle.h"
+#include "./DiagnosticsLog.h"
+
+#include <vector>
+
+namespace Fluid
+{
+    struct FluidOptions;
+    struct FluidAttractor;
+
+    struct WatchdogOptions
+    {
+        // a snapshot is kept every snapshotInterval steps, the last numSnapshots are kept
+        int snapshotInterval = 30;
+        int numSnapshots = 4;
+
+        // a step is unstable if any particle is faster than this
+        float maxSpeed = 5000.0f;
+
+        // or if kinetic energy grows by more than this factor in a single step,
+        // only checked once the rms speed is above maxEnergyGrowthMinSpeed so falling from rest doesn't count
+        float maxEnergyGrowth = 4.0f;
+        float maxEnergyGrowthMinSpeed = 200.0f;
+
+        // or if the largest density error (see FluidDiagnostics) is above this, 0 to disable,
+        // 100 is well above the largest errors of stable runs (about 60 with SPH and its low rest density, 1 with PCISPH and PBF)
+        float maxDensityError = 100.0f;
+
+        // every rollback halves dt down to minDtScale of the original,
+        // it is doubled again after recoverySteps stable steps in a row
+        float minDtScale = 1.0f / 16.0f;
+        int recoverySteps = 240;
+    };
+
+    enum WatchdogReason
+    {
+        WATCHDOG_NOT_FINITE,
+        WATCHDOG_MAX_SPEED,
+        WATCHDOG_ENERGY_GROWTH,
+        WATCHDOG_DENSITY_ERROR,
+    };
+
+    struct WatchdogEvent
+    {
+        // step the instability was detected on
+        int step;
+        WatchdogReason reason;
+
+        // step the fluid was rolled back to, -1 if there was no snapshot to roll back to
+        int rollbackStep;
+        float dtScale;
+    };
+
+    /**
+     * Detects unstable steps from their diagnostics and keeps in memory snapshots to roll back to.
+     *
+     * Snapshots are checkpoints (see Checkpoint.h) in a ring of reused buffers.
+     * An unstable step rolls back to the latest snapshot and halves dt, if dt is already at its minimum
+     * the latest snapshot is thrown away and an older one is used. Once every snapshot has been used up the
+     * watchdog gives up and the fluid carries on unguarded.
+     */
+    class Watchdog
+    {
+    public:
+        Watchdog(const WatchdogOptions &options);
+
+        /**
+         * Checks the diagnostics of a step, stable steps count towards raising dt again.
+         *
+         * @param totalMass The total mass of the particles, to get the rms speed from kinetic energy.
+         * @return False if the step was unstable.
+         */
+        bool check(const FluidDiagnostics &diagnostics, float totalMass);
+
+        bool shouldSnapshot(int step);
+        void snapshot(int step, const FluidOptions &fluidOptions, const std::vector<Particle *> &particles, const std::vector<FluidAttractor> &attractors);
+
+        /**
+         * Picks the snapshot to roll back to after check failed, lowering dt and logging the event.
+         *
+         * @param step Set to the step of the snapshot.
+         * @return The snapshot's checkpoint data or nullptr if there is nothing left to roll back to.
+         */
+        const std::vector<char> *rollback(int &step);
+
+        float getDtScale();
+        bool hasFailed();
+        const std::vector<WatchdogEvent> &getEvents();
+        WatchdogOptions &getOptions();
+
+    private:
+        struct Snapshot
+        {
+            int step;
+            std::vector<char> data;
+        };
+
+        WatchdogOptions options;
+
+        std::vector<Snapshot> snapshots;
+        int newestSnapshot = -1;
+        int numSnapshots = 0;
+
+        float dtScale = 1.0f;
+        int stableSteps = 0;
+        bool failed = false;
+
+        // -1 when there's no previous step to compare to
+        double lastKineticEnergy = -1;
+
+        int lastStep = 0;
+        WatchdogReason lastReason;
+        std::vector<WatchdogEvent> events;
+    };
+}
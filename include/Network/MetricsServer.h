@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../Utility/Metrics.h"
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <thread>
+
+namespace Network
+{
+    /**
+     * Serves a metrics registry over HTTP on localhost, GET /metrics returns every metric as plain text.
+     *
+     * Requests are answered one at a time on the server's own thread.
+     */
+    class MetricsServer
+    {
+    public:
+        MetricsServer(Utility::MetricsRegistry &registry);
+        ~MetricsServer();
+
+        /**
+         * @return False if the port couldn't be listened on.
+         */
+        bool start(unsigned short port);
+        void stop();
+        bool isRunning();
+
+    private:
+        void run();
+        void respond(sf::TcpSocket &socket);
+
+        Utility::MetricsRegistry &registry;
+
+        sf::TcpListener listener;
+        std::thread thread;
+        std::atomic<bool> running = false;
+    };
+}
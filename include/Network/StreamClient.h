@@ -0,0 +1,61 @@
+#pragma once
+
+#include "./StreamProtocol.h"
+
+#include <SFML/Network.hpp>
+#include <glm/vec2.hpp>
+#include <string>
+#include <vector>
+
+namespace Network
+{
+    /**
+     * Receives particle frames from a StreamServer.
+     */
+    class StreamClient
+    {
+    public:
+        /**
+         * Connects to a server and waits for its hello.
+         *
+         * @return False if the server couldn't be reached or isn't a compatible server.
+         */
+        bool connect(const std::string &host, unsigned short port, float timeoutSeconds = 5.0f);
+        void disconnect();
+        bool isConnected();
+
+        /**
+         * Receives whatever has arrived without blocking and decodes any frames in it.
+         *
+         * @return True if a new frame was decoded.
+         */
+        bool poll();
+
+        const std::vector<glm::vec2> &getPositions();
+        uint64_t getFrame();
+        int getBits();
+
+        Fluid::AABB getBounds();
+        float getParticleRadius();
+
+    private:
+        /**
+         * Decodes every whole message in the buffer.
+         *
+         * @return False if a message was malformed.
+         */
+        bool handleMessages(bool &newFrame);
+
+        sf::TcpSocket socket;
+        bool connected = false;
+
+        std::vector<uint8_t> buffer;
+        bool hasHello = false;
+        StreamProtocol::Hello hello;
+
+        StreamProtocol::Frame frame{0, false, 16, 0};
+        std::vector<uint16_t> values;
+        std::vector<uint16_t> previous;
+        std::vector<glm::vec2> positions;
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../Fluid/AABB.h"
+
+#include <glm/vec2.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Network
+{
+    /**
+     * Messages sent by StreamServer to StreamClient.
+     *
+     * Every message is a MessageHeader followed by size bytes of payload.
+     * The server sends a Hello when a client connects and then frames.
+     *
+     * A frame's payload is its frame number (varint), flags (byte), precision in bits (byte), number of particles (varint),
+     * then the quantised x positions of every particle followed by the y positions.
+     * Positions are quantised to the given number of bits over the hello's bounds,
+     * key frames store them as is and other frames store the difference from the last frame sent to that client,
+     * see Fluid::Trajectory::encodeDeltas.
+     */
+    namespace StreamProtocol
+    {
+        const uint32_t MAGIC = 0x54534C46; // "FLST"
+        const uint32_t VERSION = 1;
+
+        // the largest message a client will accept
+        const uint32_t MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+        enum MessageType : uint8_t
+        {
+            HELLO = 1,
+            FRAME = 2,
+        };
+
+        enum FrameFlags : uint8_t
+        {
+            KEY_FRAME = 1,
+        };
+
+        struct MessageHeader
+        {
+            uint32_t size;
+            uint8_t type;
+        };
+
+        const size_t MESSAGE_HEADER_SIZE = 5;
+
+        struct Hello
+        {
+            uint32_t magic;
+            uint32_t version;
+            Fluid::AABB bounds;
+            float particleRadius;
+        };
+
+        struct Frame
+        {
+            uint64_t frame;
+            bool keyFrame;
+            int bits;
+            int numParticles;
+        };
+
+        /**
+         * Quantises positions to 16 bits over the bounds, x positions first then y positions.
+         */
+        void quantisePositions(const std::vector<glm::vec2> &positions, const Fluid::AABB &bounds, std::vector<uint16_t> &out);
+
+        /**
+         * Reduces 16 bit quantised values to the given number of bits.
+         */
+        void reducePrecision(const std::vector<uint16_t> &values, int bits, std::vector<uint16_t> &out);
+        void dequantisePositions(const std::vector<uint16_t> &values, int bits, const Fluid::AABB &bounds, std::vector<glm::vec2> &out);
+
+        void writeHello(std::vector<uint8_t> &out, const Hello &hello);
+
+        /**
+         * Appends a frame message to out.
+         *
+         * @param values Quantised positions at frame.bits precision, see quantisePositions.
+         * @param previous The values of the last frame sent at the same precision, ignored for key frames.
+         */
+        void writeFrame(std::vector<uint8_t> &out, const Frame &frame, const uint16_t *values, const uint16_t *previous);
+
+        /**
+         * Reads a message header from the start of data.
+         *
+         * @return False if there isn't a whole header yet.
+         */
+        bool readMessageHeader(const uint8_t *data, size_t size, MessageHeader &header);
+
+        /**
+         * Reads a frame payload, values must already be sized for the frame's particles when previous is used.
+         *
+         * @param previous The values decoded from the last frame, ignored for key frames.
+         * @return False if the payload is malformed.
+         */
+        bool readFrame(const uint8_t *data, size_t size, Frame &frame, std::vector<uint16_t> &values, const std::vector<uint16_t> &previous);
+    }
+}
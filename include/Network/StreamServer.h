@@ -0,0 +1,115 @@
+#pragma once
+
+#include "./StreamProtocol.h"
+#include "../Fluid/Particle.h"
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Network
+{
+    struct StreamClientStats
+    {
+        int bits;
+        int frameInterval;
+        int framesSent;
+        int framesDropped;
+    };
+
+    /**
+     * Streams particle frames over TCP to any number of StreamClients.
+     *
+     * Frames are submitted from the simulation thread and sent from the server's own thread,
+     * submitting only copies the positions so the simulation is never held up by clients.
+     *
+     * Each client has at most one frame waiting to be sent, if a new frame arrives while the last one is still
+     * being sent to a client the new frame is dropped for that client. Clients that keep dropping frames have
+     * their precision and then frame rate lowered, clients that keep up have them raised again.
+     */
+    class StreamServer
+    {
+    public:
+        StreamServer();
+        ~StreamServer();
+
+        /**
+         * Starts listening for clients.
+         *
+         * @param bounds The region positions are quantised over.
+         * @return False if the port couldn't be listened on.
+         */
+        bool start(unsigned short port, const Fluid::AABB &bounds, float particleRadius);
+        void stop();
+        bool isRunning();
+
+        void submit(const std::vector<Fluid::Particle *> &particles);
+
+        int getNumClients();
+        std::vector<StreamClientStats> getClientStats();
+
+        /**
+         * @return Frames dropped across every client since the server started, including clients that have disconnected.
+         */
+        int getDroppedFrames();
+
+    private:
+        struct Client
+        {
+            sf::TcpSocket socket;
+
+            // encoded messages and how much of them has been sent
+            std::vector<uint8_t> pending;
+            size_t sent = 0;
+
+            // last frame sent, deltas are taken from it
+            std::vector<uint16_t> previous;
+            bool needsKeyFrame = true;
+            int framesSinceKeyFrame = 0;
+
+            // adaptation
+            int bits = 16;
+            int frameInterval = 1;
+            int framesSinceSent = 0;
+            int sentStreak = 0;
+
+            int framesSent = 0;
+            int framesDropped = 0;
+        };
+
+        void run();
+        void acceptClients();
+
+        /**
+         * @return False if the client disconnected.
+         */
+        bool flushClient(Client *client);
+        void sendFrame(Client *client, uint64_t frame);
+        void adapt(Client *client, bool dropped);
+
+        sf::TcpListener listener;
+        std::thread thread;
+        std::atomic<bool> running = false;
+
+        StreamProtocol::Hello hello;
+
+        // latest submitted frame, swapped with frame when the server takes it
+        std::mutex submitMutex;
+        std::condition_variable submitted;
+        std::vector<glm::vec2> submittedPositions;
+        uint64_t submittedFrame = 0;
+
+        // only used by the server thread
+        std::vector<glm::vec2> positions;
+        std::vector<uint16_t> quantised;
+        std::vector<uint16_t> reduced;
+        uint64_t frame = 0;
+        std::atomic<int> droppedFrames = 0;
+
+        std::mutex clientsMutex;
+        std::vector<Client *> clients;
+    };
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "./Shapes/Circle.h"
+#include "./Shapes/Rect.h"
+#include "./Color.h"
+#include "./RenderType.h"
+
+#include <SFML/Graphics.hpp>
+#include <glm/vec2.hpp>
+#include <vector>
+
+namespace Rendering
+{
+    /**
+     * Batches debug shapes so a whole frame of them is drawn in two draw calls.
+     *
+     * Shapes are only stored as vertices until draw is called, filled shapes are drawn first and then lines.
+     * The vertex storage is kept between frames.
+     */
+    class DebugDraw
+    {
+    public:
+        void line(glm::vec2 start, glm::vec2 end, const Color &color);
+        void rect(const Rect &rect, const Color &color, RenderType renderType = RenderType::STROKE);
+        void circle(const Circle &circle, const Color &color, RenderType renderType = RenderType::STROKE, int segments = 24);
+
+        bool isEmpty();
+        void clear();
+
+        void draw(sf::RenderTarget &target);
+
+    private:
+        std::vector<sf::Vertex> lines;
+        std::vector<sf::Vertex> triangles;
+    };
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Rendering
+{
+    struct ExportOptions
+    {
+        // printf style pattern for image files, e.g. "frames/frame_%05d.png", the extension picks the format,
+        // it must hold exactly one integer conversion (%d, %i or %u with optional flags and width) and any other % written as %%
+        std::string outputPattern;
+
+        // if set raw RGBA frames are piped to this command instead of writing images, e.g. an ffmpeg command
+        std::string pipeCommand;
+
+        // resolution of exported frames, independent of the window
+        int width;
+        int height;
+
+        int numWorkers;
+    };
+
+    /**
+     * Encodes frames on worker threads.
+     *
+     * Frames either come from a texture or straight from CPU pixels, which never touches the GPU.
+     *
+     * Frames are read back into a small ring of images and handed to the workers,
+     * so encoding one frame overlaps with rendering the next ones.
+     * Submitting waits for a free image when the workers fall behind, frames are never dropped.
+     */
+    class FrameExporter
+    {
+    public:
+        FrameExporter(const ExportOptions &options);
+        ~FrameExporter();
+
+        bool start();
+
+        /**
+         * Reads back the texture and queues it to be encoded.
+         */
+        void submit(const sf::Texture &texture);
+
+        /**
+         * Copies packed RGBA pixels and queues them to be encoded, composited over black like a cleared render texture.
+         */
+        void submit(const uint32_t *pixels, int width, int height);
+
+        /**
+         * Waits for all queued frames to be encoded then stops the workers.
+         */
+        void finish();
+
+        int getFramesSubmitted();
+        int getFramesWritten();
+
+    private:
+        struct Slot
+        {
+            sf::Image image;
+            int frame;
+
+            // pixels over black before they are copied into the image, only used for cpu frames
+            std::vector<uint32_t> pixels;
+        };
+
+        /**
+         * Waits for a free slot in the ring.
+         */
+        int acquireSlot();
+
+        /**
+         * Numbers the slot's frame and hands it to the workers.
+         */
+        void queueSlot(int slot);
+
+        /**
+         * Checks the output pattern is safe to give to snprintf with a single int.
+         */
+        static bool isValidPattern(const std::string &pattern);
+
+        void workerThread();
+        bool writeFrame(Slot &slot);
+
+        ExportOptions options;
+
+        static const int RING_SIZE = 4;
+        Slot ring[RING_SIZE];
+        std::vector<int> freeSlots;
+        std::deque<int> queuedSlots;
+
+        std::mutex mutex;
+        std::condition_variable queuedCondition;
+        std::condition_variable freeCondition;
+        std::vector<std::thread> workers;
+        bool finishing = false;
+        bool running = false;
+
+        FILE *pipe = nullptr;
+
+        int framesSubmitted = 0;
+        int framesWritten = 0;
+    };
+}
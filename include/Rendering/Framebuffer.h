@@ -0,0 +1,80 @@
+#pragma once
+
+#include "./Color.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Rendering
+{
+    /**
+     * A persistent RGBA pixel buffer.
+     *
+     * Writes are clipped to the buffer and record which rows changed, so only those rows need uploading to a texture,
+     * clearing only touches rows that have been drawn to since the last clear.
+     */
+    class Framebuffer
+    {
+    public:
+        Framebuffer(int width, int height);
+
+        void resize(int width, int height);
+
+        int getWidth();
+        int getHeight();
+
+        /**
+         * Pixels are packed RGBA bytes, see pack.
+         * Anything written directly must be marked with markDirty.
+         */
+        uint32_t *getPixels();
+
+        /**
+         * Clears the buffer to transparent.
+         */
+        void clear();
+
+        void pixel(int x, int y, const Color &color);
+
+        /**
+         * Fills the pixels from startX to endX (inclusive) on row y.
+         */
+        void span(int startX, int endX, int y, const Color &color);
+        void rect(int x, int y, int w, int h, const Color &color);
+
+        /**
+         * Copies a w by h block of packed pixels into the buffer with its top left at x, y.
+         */
+        void write(int x, int y, int w, int h, const uint32_t *pixels);
+
+        /**
+         * Marks rows startRow to endRow (inclusive) as changed.
+         */
+        void markDirty(int startRow, int endRow);
+
+        bool isDirty();
+        int getDirtyStart();
+        int getDirtyEnd();
+
+        /**
+         * Called once the dirty rows have been uploaded.
+         */
+        void clearDirty();
+
+        static uint32_t pack(const Color &color);
+
+    private:
+        int width;
+        int height;
+
+        std::vector<uint32_t> pixels;
+
+        // rows changed since the last upload
+        int dirtyStart;
+        int dirtyEnd;
+
+        // rows drawn to since the last clear
+        int contentStart;
+        int contentEnd;
+    };
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace Rendering
+{
+    enum RenderType
+    {
+        STROKE,
+        FILL
+    };
+}
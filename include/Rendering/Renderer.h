@@ -3,19 +3,29 @@
 #include "./Shapes/Circle.h"
 #include "./Shapes/Rect.h"
 #include "./Color.h"
+#include "./RenderType.h"
+#include "./DebugDraw.h"
+#include "./FrameExporter.h"
+#include "./Framebuffer.h"
+#include "./SoftwareRasterizer.h"
 #include "../Utility/EventEmitter.h"
+#include "../Utility/EventQueue.h"
+#include "../Utility/InputCodes.h"
 
 #include <SFML/Graphics.hpp>
 #include <string>
 #include <vector>
 #include <functional>
+#include <variant>
 
 namespace Rendering
 {
-    enum RenderType
+    enum CirclesBackend
     {
-        STROKE,
-        FILL
+        BATCHED_CIRCLES,
+        SHADER_CIRCLES,
+        SOFTWARE_CIRCLES,
+        SOFTWARE_METABALLS,
     };
 
     enum RendererEventType
@@ -32,7 +42,7 @@ namespace Rendering
     struct RendererEvent
     {
         RendererEventType type;
-        void *data;
+        std::variant<std::monostate, glm::vec2, Utility::MouseButton, Utility::KeyCode> data;
     };
 
     /**
@@ -41,13 +51,16 @@ namespace Rendering
      * This class is responsible for rendering shapes to the screen and handling window/input events.
      *
      * Events:
-     * - WINDOW_CLOSE, data: nullptr
+     * - WINDOW_CLOSE, data: std::monostate
      * - WINDOW_RESIZE, data: glm::vec2
      * - MOUSE_MOVE, data: glm::vec2
      * - MOUSE_DOWN, data: Utility::MouseButton
      * - MOUSE_UP, data: Utility::MouseButton
      * - KEY_DOWN, data: Utility::KeyCode
      * - KEY_UP, data: Utility::KeyCode
+     *
+     * Events are put into a fixed size queue as they are polled and sent to listeners when the queue is dispatched,
+     * the queue can be dispatched from a different thread to the one polling.
      */
     class Renderer : public EventEmitter<RendererEventType, RendererEvent>
     {
@@ -55,21 +68,50 @@ namespace Rendering
         Renderer(std::string windowTitle, int windowWidth, int windowHeight);
         ~Renderer();
 
-        int init();
+        /**
+         * Initializes the renderer.
+         *
+         * @param headless If true no window is created, frames can only be exported.
+         */
+        int init(bool headless = false);
         void destroy();
 
         /**
-         * Polls events from the renderer.
+         * Polls events from the renderer and dispatches them.
          *
          * @return True if the application should exit.
          */
         bool pollEvents();
 
+        /**
+         * Polls window events into the event queue, must be called on the thread that created the window.
+         * Events are dropped if the queue is full.
+         *
+         * @return True if the window was closed.
+         */
+        bool queueEvents();
+
+        /**
+         * Sends queued events to their listeners.
+         */
+        void dispatchEvents();
+
         void clear();
         void present();
         void presentDrawnPixels();
 
+        /**
+         * Pixel methods draw into a persistent pixel buffer that is drawn by presentDrawnPixels.
+         * Writes outside of the window are clipped.
+         */
         void pixel(glm::vec2 position, const Color &color);
+        void pixelSpan(int startX, int endX, int y, const Color &color);
+        void pixelRect(int x, int y, int w, int h, const Color &color);
+
+        /**
+         * The pixel buffer, for writing blocks of pixels at once.
+         */
+        Framebuffer *getPixelBuffer();
 
         void line(glm::vec2 start, glm::vec2 end, const Color &color);
         void circle(const Circle &circle, const Color &color, RenderType renderType = RenderType::FILL);
@@ -83,8 +125,56 @@ namespace Rendering
          */
         void polygon(const std::vector<glm::vec2> &vertices, const Color &color, RenderType renderType = RenderType::FILL);
 
+        /**
+         * Debug shapes are batched and drawn over everything else when the frame is presented.
+         */
+        DebugDraw *getDebugDraw();
+
         void shaderCircles(Circle circles[], Color colors[], int numCircles);
 
+        /**
+         * Draws the circles as textured quads in a single draw call.
+         *
+         * Unlike shaderCircles the cost scales with the area the circles cover rather than the screen area times the number of circles.
+         * Earlier circles are drawn on top of later ones like shaderCircles.
+         */
+        void batchedCircles(Circle circles[], Color colors[], int numCircles);
+
+        /**
+         * Draws the circles on the CPU with the software rasterizer, for machines without a usable GPU.
+         *
+         * @param metaballs If true a smooth surface through the circles is drawn instead of the circles themselves.
+         */
+        void softwareCircles(Circle circles[], Color colors[], int numCircles, bool metaballs = false);
+
+        /**
+         * Draws the circles with the current circles backend.
+         */
+        void circles(Circle circles[], Color colors[], int numCircles);
+
+        void setCirclesBackend(CirclesBackend backend);
+        CirclesBackend getCirclesBackend();
+
+        /**
+         * Starts rendering to an offscreen target at the export resolution, every presented frame is then exported.
+         *
+         * Shapes are still given in window coordinates and scaled to the export resolution.
+         * If there is a window it shows a preview of the exported frames.
+         *
+         * If a software circles backend is set the circles are rasterized straight into the exported pixels and nothing touches the GPU,
+         * so headless machines without a GL context can export. Only the circles are exported then, other shapes are only previewed.
+         *
+         * @return False if the offscreen target or exporter couldn't be created.
+         */
+        bool startExport(const ExportOptions &options);
+
+        /**
+         * Waits for exported frames to finish encoding and goes back to rendering to the window.
+         */
+        void stopExport();
+        bool isExporting();
+        int getExportedFrames();
+
         // gui methods
 
         void createLabel(std::string text, glm::vec2 position, glm::vec2 size);
@@ -96,10 +186,45 @@ namespace Rendering
         int windowWidth;
         int windowHeight;
 
-        sf::Image *pixelImage;
-        sf::RenderWindow *window;
+        Framebuffer *pixelBuffer = nullptr;
+        sf::Texture *pixelTexture = nullptr;
+
+        /**
+         * Uploads the dirty rows of the framebuffer to its texture and draws it over the target.
+         *
+         * @param scale Scale from window coordinates to framebuffer pixels.
+         */
+        void drawFramebuffer(Framebuffer *framebuffer, sf::Texture *&texture, glm::vec2 scale);
+        sf::RenderWindow *window = nullptr;
+
+        Utility::EventQueue<RendererEvent, 256> events;
+
+        // what shapes are drawn to, either the window or the export texture
+        sf::RenderTarget *target = nullptr;
+        glm::vec2 getTargetScale();
+
+        sf::RenderTexture *exportTexture = nullptr;
+
+        // exported pixels when exporting from a software backend, there is no render texture then
+        Framebuffer *exportBuffer = nullptr;
+        FrameExporter *exporter = nullptr;
+
+        // loaded on first use so renderers that never draw shader circles never need a GL context
+        sf::Shader *circlesShader = nullptr;
+        bool circlesShaderFailed = false;
+        void loadCirclesShader();
+
+        DebugDraw *debugDraw = nullptr;
+
+        // persistent quads for batchedCircles, textured with an antialiased disc
+        sf::VertexArray *circleVertices = nullptr;
+        sf::Texture *circleTexture = nullptr;
+        void createCircleTexture();
 
-        sf::Shader *circlesShader;
+        CirclesBackend circlesBackend = CirclesBackend::BATCHED_CIRCLES;
+        SoftwareRasterizer *rasterizer = nullptr;
+        Framebuffer *rasterBuffer = nullptr;
+        sf::Texture *rasterTexture = nullptr;
     };
 
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <glm/vec2.hpp>
 
 namespace Rendering
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "./Shapes/Circle.h"
+#include "./Color.h"
+#include "./Framebuffer.h"
+
+#include <glm/vec2.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace Rendering
+{
+    /**
+     * Multithreaded CPU renderer for particles.
+     *
+     * The framebuffer is split into square tiles and circles are binned into the tiles they overlap,
+     * each thread then takes whole tiles so no two threads ever write the same pixel.
+     * Circles are filled a row span at a time so the inner loops are plain contiguous writes the compiler can vectorise.
+     *
+     * Circles are drawn into a Framebuffer, only the rows they cover are marked dirty.
+     */
+    class SoftwareRasterizer
+    {
+    public:
+        SoftwareRasterizer(int numThreads = 4, int tileSize = 64);
+
+        /**
+         * Draws filled circles, earlier circles are drawn on top of later ones like Renderer::shaderCircles.
+         *
+         * @param scale Scale from circle coordinates to pixels.
+         */
+        void circles(Framebuffer &framebuffer, const Circle circles[], const Color colors[], int numCircles, glm::vec2 scale);
+
+        /**
+         * Draws a smooth surface through the circles.
+         *
+         * Each circle splats a smooth kernel of radius influence * its radius into a density field,
+         * pixels where the density is at least threshold are filled with the kernel weighted average of the circles' colors.
+         *
+         * @param scale Scale from circle coordinates to pixels.
+         */
+        void metaballs(Framebuffer &framebuffer, const Circle circles[], const Color colors[], int numCircles, glm::vec2 scale, float influence = 2.5f, float threshold = 0.5f);
+
+    private:
+        void setFramebuffer(Framebuffer &framebuffer);
+        void binCircles(const Circle circles[], int numCircles, glm::vec2 scale, float radiusScale);
+        void runTiles(void (SoftwareRasterizer::*func)(int));
+
+        void circlesTile(int tile);
+        void metaballsTile(int tile);
+
+        int numThreads;
+        int tileSize;
+
+        // current framebuffer
+        uint32_t *pixels;
+        int width;
+        int height;
+        int tilesX;
+        int tilesY;
+
+        // circles in tile i are binEntries[binOffsets[i]] to binEntries[binOffsets[i + 1]]
+        std::vector<int> binOffsets;
+        std::vector<int> binEntries;
+
+        // pixel rows the binned circles could touch
+        int coveredStart;
+        int coveredEnd;
+
+        // current draw call
+        const Circle *drawCircles;
+        const Color *drawColors;
+        glm::vec2 drawScale;
+        float drawInfluence;
+        float drawThreshold;
+
+        std::atomic<int> nextTile;
+    };
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Utility
+{
+    /**
+     * @return How many times operator new has been called since the program started.
+     */
+    uint64_t getAllocationCount();
+}
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <string>
-#include <bits/stdc++.h>
+#include <functional>
+#include <map>
+#include <vector>
 
 template <typename E, typename D>
 class EventEmitter
@@ -9,11 +10,11 @@ class EventEmitter
 public:
     EventEmitter();
 
-    void on(E event, std::function<void(D)> listener);
-    void emit(E event, D data);
+    void on(E event, std::function<void(const D &)> listener);
+    void emit(E event, const D &data);
 
 private:
-    std::map<E, std::vector<std::function<void(D)>>> listeners;
+    std::map<E, std::vector<std::function<void(const D &)>>> listeners;
 };
 
 template <typename E, typename D>
@@ -22,24 +23,20 @@ EventEmitter<E, D>::EventEmitter()
 }
 
 template <typename E, typename D>
-void EventEmitter<E, D>::on(E event, std::function<void(D)> listener)
+void EventEmitter<E, D>::on(E event, std::function<void(const D &)> listener)
 {
-    if (listeners.count(event) == 0)
-    {
-        listeners[event] = std::vector<std::function<void(D)>>();
-    }
-
-    listeners[event].push_back(listener);
+    listeners[event].push_back(std::move(listener));
 }
 
 template <typename E, typename D>
-void EventEmitter<E, D>::emit(E event, D data)
+void EventEmitter<E, D>::emit(E event, const D &data)
 {
-    if (listeners.count(event) == 0)
+    auto it = listeners.find(event);
+    if (it == listeners.end())
         return;
 
-    for (auto listener : listeners[event])
+    for (auto &listener : it->second)
     {
         listener(data);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace Utility
+{
+    /**
+     * A fixed capacity single producer, single consumer queue.
+     *
+     * One thread can push while another pops without locking, items are stored inline so nothing is allocated after construction.
+     */
+    template <typename T, size_t Capacity>
+    class EventQueue
+    {
+    public:
+        /**
+         * @return False if the queue is full, the item is dropped.
+         */
+        bool push(const T &item);
+
+        /**
+         * @return False if the queue is empty.
+         */
+        bool pop(T &item);
+
+        bool isEmpty();
+
+    private:
+        T items[Capacity];
+
+        // only ever increase, the slot is the count modulo the capacity
+        std::atomic<size_t> head = 0;
+        std::atomic<size_t> tail = 0;
+    };
+
+    template <typename T, size_t Capacity>
+    bool EventQueue<T, Capacity>::push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        items[t % Capacity] = item;
+        tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    template <typename T, size_t Capacity>
+    bool EventQueue<T, Capacity>::pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        item = items[h % Capacity];
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    template <typename T, size_t Capacity>
+    bool EventQueue<T, Capacity>::isEmpty()
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 namespace Utility
 {
     enum MouseButton
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Utility
+{
+    /**
+     * A read only memory mapped file.
+     *
+     * The file stays mapped until close is called or the MappedFile is destroyed.
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * Maps the file at the given path, closing any previously mapped file.
+         *
+         * @return True if the file was mapped.
+         */
+        bool open(const std::string &path);
+        void close();
+
+        const char *getData();
+        size_t getSize();
+
+    private:
+        const char *data = nullptr;
+        size_t size = 0;
+
+        // platform handles
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+        int fileDescriptor = -1;
+    };
+}
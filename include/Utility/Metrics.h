@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Utility
+{
+    class Counter
+    {
+    public:
+        void add(uint64_t amount = 1);
+        uint64_t get();
+
+    private:
+        std::atomic<uint64_t> value = 0;
+    };
+
+    class Gauge
+    {
+    public:
+        void set(double value);
+        double get();
+
+    private:
+        std::atomic<double> value = 0;
+    };
+
+    class Histogram
+    {
+    public:
+        /**
+         * @param bounds Upper bounds of the buckets in increasing order, values above the last bound go in an overflow bucket.
+         */
+        Histogram(const std::vector<double> &bounds);
+
+        /**
+         * Records count observations of value.
+         */
+        void observe(double value, uint64_t count = 1);
+
+        const std::vector<double> &getBounds();
+
+        /**
+         * @return The number of observations in bucket i, bucket bounds.size() is the overflow bucket.
+         */
+        uint64_t getBucket(int i);
+        uint64_t getCount();
+        double getSum();
+
+    private:
+        std::vector<double> bounds;
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+        std::atomic<uint64_t> count = 0;
+        std::atomic<double> sum = 0;
+    };
+
+    /**
+     * Named counters, gauges and histograms that can be scraped as text.
+     *
+     * Adding metrics takes a lock, so metrics should be added once up front,
+     * after that updating a metric is a relaxed atomic operation and never blocks.
+     * Metrics live as long as the registry.
+     */
+    class MetricsRegistry
+    {
+    public:
+        Counter *addCounter(const std::string &name, const std::string &help);
+        Gauge *addGauge(const std::string &name, const std::string &help);
+        Histogram *addHistogram(const std::string &name, const std::string &help, const std::vector<double> &bounds);
+
+        /**
+         * Formats every metric in the Prometheus text exposition format.
+         */
+        std::string format();
+
+    private:
+        struct Metric
+        {
+            std::string name;
+            std::string help;
+
+            // only one is set
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Gauge> gauge;
+            std::unique_ptr<Histogram> histogram;
+        };
+
+        std::mutex mutex;
+        std::vector<Metric> metrics;
+    };
+}
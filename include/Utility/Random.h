@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Utility
+{
+    /**
+     * Counter based random numbers, the same key always gives the same number.
+     *
+     * Unlike rand() there is no shared state, so any thread can draw numbers in any order
+     * and the results only depend on the keys.
+     */
+    namespace Random
+    {
+        /**
+         * Mixes a 64 bit key into a well distributed 64 bit value. (splitmix64 finaliser)
+         */
+        inline uint64_t hash(uint64_t key)
+        {
+            key += 0x9E3779B97F4A7C15ull;
+            key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+            key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+            return key ^ (key >> 31);
+        }
+
+        inline uint64_t hash(uint64_t a, uint64_t b)
+        {
+            return hash(hash(a) ^ b);
+        }
+
+        inline uint64_t hash(uint64_t a, uint64_t b, uint64_t c)
+        {
+            return hash(hash(a, b) ^ c);
+        }
+
+        /**
+         * @return A float in [0, 1) from a hash.
+         */
+        inline float uniform(uint64_t hash)
+        {
+            return static_cast<float>(hash >> 40) / static_cast<float>(1 << 24);
+        }
+    }
+}
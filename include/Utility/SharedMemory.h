@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Utility
+{
+    /**
+     * A named block of memory shared between processes.
+     *
+     * Uses POSIX shared memory, or a named file mapping on Windows.
+     * The process that creates the block removes its name again when it closes it.
+     */
+    class SharedMemory
+    {
+    public:
+        SharedMemory();
+        ~SharedMemory();
+
+        SharedMemory(const SharedMemory &) = delete;
+        SharedMemory &operator=(const SharedMemory &) = delete;
+
+        /**
+         * Creates a block of the given size, replacing any existing block with the same name.
+         *
+         * @return True if the block was created and mapped.
+         */
+        bool create(const std::string &name, size_t size);
+
+        /**
+         * Maps an existing block read only.
+         *
+         * @return True if the block was mapped.
+         */
+        bool open(const std::string &name);
+        void close();
+
+        char *getData();
+        size_t getSize();
+
+    private:
+        std::string getPlatformName(const std::string &name);
+
+        char *data = nullptr;
+        size_t size = 0;
+        bool owner = false;
+        std::string name;
+
+        // platform handles
+        void *mappingHandle = nullptr;
+    };
+}
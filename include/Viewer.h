@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../include/Rendering/Renderer.h"
+#include "../include/Network/StreamClient.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Shows particles streamed from an Application running with a StreamServer.
+ */
+class Viewer
+{
+public:
+    Viewer(std::string windowTitle, int windowWidth, int windowHeight);
+    ~Viewer();
+
+    int run(const std::string &host, unsigned short port);
+
+private:
+    std::string windowTitle;
+    int windowWidth;
+    int windowHeight;
+
+    Rendering::Renderer *renderer = nullptr;
+    Network::StreamClient client;
+
+    std::vector<Rendering::Circle> circles;
+    std::vector<Rendering::Color> colors;
+
+    void render();
+};
@@ -1,7 +1,231 @@
 #include "./include/Application.h"
+#include "./include/Viewer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
 
 int main(int argv, char **args)
 {
     Application app("Fluid Sim", 1400, 1000);
+
+    // export mode
+    // --export <pattern>         write frames as images, e.g. frames/frame_%05d.png
+    // --export-pipe <command>    pipe raw RGBA frames to a command, e.g. an ffmpeg command
+    // --size <width>x<height>    export resolution (default 1920x1080)
+    // --frames <count>           number of frames to export (default 600)
+    // --workers <count>          number of encoding threads (default 4)
+    // --headless                 don't open a window
+    // --renderer <batched|shader|software|metaballs>  how particles are drawn (default batched),
+    //                            the software renderers export without a GPU
+    //
+    // --publish <name>           publish every step into shared memory for other processes
+    //
+    // --serve <port>             stream every step to viewers, add --headless to run without a window
+    // --view <host>:<port>       view a simulation streamed with --serve
+    //
+    // --metrics <port>           serve metrics at http://localhost:<port>/metrics
+    // --diagnostics <path>       append every step's energy, speed and density error to a CSV file
+    // --watchdog                 roll back and lower dt when the simulation blows up
+    //
+    // --verify-determinism <steps>  check runs are bitwise identical for any thread count, then exit
+    //
+    // --solver <sph|pcisph|pbf|flip>    how pressure is solved (default sph)
+    // --viscosity <value>               viscosity of the fluid (default 0.13)
+    // --implicit-viscosity              solve viscosity implicitly, so high viscosities are stable
+    //
+    // --benchmark <steps>              time the default scene, then exit
+    // --benchmark-dt <seconds>         length of a step (default 1/120)
+    // --benchmark-particles <count>    number of particles to benchmark (default 1200)
+    // --benchmark-reference <path>     write final positions to path, or compare against it if it exists
+    Rendering::ExportOptions exportOptions{"", "", 1920, 1080, 4};
+    bool exporting = false;
+    bool headless = false;
+    int numFrames = 600;
+    std::string publishName;
+    int servePort = 0;
+    std::string viewAddress;
+    int metricsPort = 0;
+    std::string diagnosticsPath;
+    bool watchdog = false;
+    int determinismSteps = 0;
+    int benchmarkSteps = 0;
+    int benchmarkParticles = 1200;
+    std::string benchmarkReference;
+    float benchmarkDt = 1.0f / 120.0f;
+    std::string solver = "sph";
+    std::string rendererName = "batched";
+    float viscosity = 0.13f;
+    bool implicitViscosity = false;
+
+    for (int i = 1; i < argv; i++)
+    {
+        bool hasValue = i + 1 < argv;
+
+        if (std::strcmp(args[i], "--export") == 0 && hasValue)
+        {
+            exportOptions.outputPattern = args[++i];
+            exporting = true;
+        }
+        else if (std::strcmp(args[i], "--export-pipe") == 0 && hasValue)
+        {
+            exportOptions.pipeCommand = args[++i];
+            exporting = true;
+        }
+        else if (std::strcmp(args[i], "--size") == 0 && hasValue)
+        {
+            std::sscanf(args[++i], "%dx%d", &exportOptions.width, &exportOptions.height);
+        }
+        else if (std::strcmp(args[i], "--frames") == 0 && hasValue)
+        {
+            numFrames = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--workers") == 0 && hasValue)
+        {
+            exportOptions.numWorkers = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--renderer") == 0 && hasValue)
+        {
+            rendererName = args[++i];
+        }
+        else if (std::strcmp(args[i], "--publish") == 0 && hasValue)
+        {
+            publishName = args[++i];
+        }
+        else if (std::strcmp(args[i], "--serve") == 0 && hasValue)
+        {
+            servePort = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--view") == 0 && hasValue)
+        {
+            viewAddress = args[++i];
+        }
+        else if (std::strcmp(args[i], "--metrics") == 0 && hasValue)
+        {
+            metricsPort = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--diagnostics") == 0 && hasValue)
+        {
+            diagnosticsPath = args[++i];
+        }
+        else if (std::strcmp(args[i], "--watchdog") == 0)
+        {
+            watchdog = true;
+        }
+        else if (std::strcmp(args[i], "--verify-determinism") == 0 && hasValue)
+        {
+            determinismSteps = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--benchmark") == 0 && hasValue)
+        {
+            benchmarkSteps = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--benchmark-particles") == 0 && hasValue)
+        {
+            benchmarkParticles = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--benchmark-reference") == 0 && hasValue)
+        {
+            benchmarkReference = args[++i];
+        }
+        else if (std::strcmp(args[i], "--benchmark-dt") == 0 && hasValue)
+        {
+            benchmarkDt = std::atof(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--solver") == 0 && hasValue)
+        {
+            solver = args[++i];
+        }
+        else if (std::strcmp(args[i], "--viscosity") == 0 && hasValue)
+        {
+            viscosity = std::atof(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--implicit-viscosity") == 0)
+        {
+            implicitViscosity = true;
+        }
+        else if (std::strcmp(args[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+        else
+        {
+            std::cout << "Unknown argument: " << args[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!viewAddress.empty())
+    {
+        auto colon = viewAddress.rfind(':');
+        if (colon == std::string::npos)
+        {
+            std::cout << "Expected --view <host>:<port>" << std::endl;
+            return 1;
+        }
+
+        Viewer viewer("Fluid Sim Viewer", 1400, 1000);
+        return viewer.run(viewAddress.substr(0, colon), std::atoi(viewAddress.c_str() + colon + 1));
+    }
+
+    if (solver == "pcisph")
+    {
+        app.setSolver(Fluid::SolverType::PCISPH_SOLVER);
+    }
+    else if (solver == "pbf")
+    {
+        app.setSolver(Fluid::SolverType::PBF_SOLVER);
+    }
+    else if (solver == "flip")
+    {
+        app.setSolver(Fluid::SolverType::FLIP_SOLVER);
+    }
+    else if (solver != "sph")
+    {
+        std::cout << "Unknown solver: " << solver << std::endl;
+        return 1;
+    }
+
+    app.setViscosity(viscosity, implicitViscosity);
+
+    const char *rendererNames[] = {"batched", "shader", "software", "metaballs"};
+    int backend = 0;
+
+    while (backend < 4 && rendererName != rendererNames[backend])
+        backend++;
+
+    if (backend == 4)
+    {
+        std::cout << "Unknown renderer: " << rendererName << std::endl;
+        return 1;
+    }
+
+    app.setCirclesBackend(static_cast<Rendering::CirclesBackend>(backend));
+
+    if (determinismSteps > 0)
+        return app.verifyDeterminism(determinismSteps);
+
+    if (benchmarkSteps > 0)
+        return app.benchmark(benchmarkSteps, benchmarkParticles, benchmarkDt, benchmarkReference);
+
+    if (exporting)
+        app.setExport(exportOptions, numFrames, headless);
+
+    if (servePort != 0)
+        app.setServe(servePort, headless);
+
+    if (!publishName.empty())
+        app.setPublish(publishName);
+
+    if (metricsPort != 0)
+        app.setMetrics(metricsPort);
+
+    if (!diagnosticsPath.empty())
+        app.setDiagnostics(diagnosticsPath);
+
+    if (watchdog)
+        app.setWatchdog(true);
+
     return app.run();
-}
\ No newline at end of file
+}
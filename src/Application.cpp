@@ -3,6 +3,7 @@
 #include "../include/Globals.h"
 #include "../include/Utility/Timestep.h"
 #include "../include/Utility/InputCodes.h"
+#include "../include/Utility/AllocationCounter.h"
 
 #include <glm/glm.hpp>
 #include <math.h>
@@ -11,6 +12,8 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <fstream>
+#include <algorithm>
 
 Application::Application(std::string windowTitle, int windowWidth, int windowHeight) : windowTitle(windowTitle), windowWidth(windowWidth), windowHeight(windowHeight)
 {
@@ -21,6 +24,56 @@ Application::~Application()
     destroy();
 }
 
+void Application::setSolver(Fluid::SolverType solver)
+{
+    this->solver = solver;
+}
+
+void Application::setViscosity(float viscosity, bool implicit)
+{
+    this->viscosity = viscosity;
+    implicitViscosity = implicit;
+}
+
+void Application::setPublish(const std::string &name)
+{
+    publishName = name;
+}
+
+void Application::setServe(unsigned short port, bool headless)
+{
+    this->servePort = port;
+    this->headless = headless;
+}
+
+void Application::setCirclesBackend(Rendering::CirclesBackend backend)
+{
+    circlesBackend = backend;
+}
+
+void Application::setDiagnostics(const std::string &path)
+{
+    diagnosticsPath = path;
+}
+
+void Application::setWatchdog(bool enabled)
+{
+    useWatchdog = enabled;
+}
+
+void Application::setMetrics(unsigned short port)
+{
+    metricsPort = port;
+}
+
+void Application::setExport(const Rendering::ExportOptions &exportOptions, int numFrames, bool headless)
+{
+    this->exporting = true;
+    this->exportOptions = exportOptions;
+    this->exportFrames = numFrames;
+    this->headless = headless;
+}
+
 int Application::run()
 {
     const int initCode = init();
@@ -62,8 +115,10 @@ int Application::run()
         update(desiredDt);
         auto updateTime = timeSinceEpochMillisec() - startTime;
 
+        // nothing to draw to when headless unless exporting
         startTime = timeSinceEpochMillisec();
-        render();
+        if (!headless || exporting)
+            render();
         auto renderTime = timeSinceEpochMillisec() - startTime;
 
         // print timestep info
@@ -71,8 +126,25 @@ int Application::run()
                   << " | events: " << eventTime << "ms"
                   << " | update: " << updateTime << "ms"
                   << " | render: " << renderTime << "ms"
+                  << " | grid churn: " << fluid->getStats().gridChurn * 100.0f << "%"
+                  << " | density error: " << fluid->getDiagnostics().meanDensityError * 100.0f << "%"
+                  << " | viewers: " << (server == nullptr ? 0 : server->getNumClients())
                   << " | fps: " << 1.0f / dt << "        ";
 
+        if (exporting)
+        {
+            std::cout << "\rexported: " << renderer->getExportedFrames() << " | frames left: " << exportFrames - 1 << "        ";
+
+            // export as fast as possible
+            if (--exportFrames <= 0)
+            {
+                renderer->stopExport();
+                state = ApplicationState::EXIT;
+            }
+
+            continue;
+        }
+
         // wait until frame time is reached
         const auto frameEndTime = now + desiredFrameTime;
         while (timeSinceEpochMillisec() < frameEndTime)
@@ -88,13 +160,75 @@ int Application::init()
 {
     // init renderer
     renderer = new Rendering::Renderer(windowTitle, windowWidth, windowHeight);
-    if (renderer->init() != 0)
+    if (renderer->init(headless) != 0)
     {
         std::cout << "Failed to initialize renderer." << std::endl;
         return 1;
     }
 
+    // export picks its target from the backend
+    renderer->setCirclesBackend(circlesBackend);
+
+    if (exporting)
+    {
+        if (!renderer->startExport(exportOptions))
+        {
+            std::cout << "Failed to start export." << std::endl;
+            return 1;
+        }
+
+        paused = false;
+    }
+
     // init fluid
+    createOptions();
+
+    fluid = new Fluid::Fluid(options);
+    fluid->init();
+
+    if (!publishName.empty() && !fluid->startPublishing(publishName))
+        std::cout << "Failed to publish to shared memory " << publishName << "." << std::endl;
+
+    if (useWatchdog)
+        fluid->enableWatchdog();
+
+    if (!diagnosticsPath.empty() && !fluid->getDiagnosticsLog().startCsv(diagnosticsPath))
+        std::cout << "Failed to open " << diagnosticsPath << " for diagnostics." << std::endl;
+
+    if (servePort != 0)
+    {
+        server = new Network::StreamServer();
+        if (!server->start(servePort, options.boundingBox, options.particleRadius))
+            return 1;
+
+        if (headless)
+            paused = false;
+    }
+
+    if (metricsPort != 0)
+    {
+        createMetrics();
+
+        metricsServer = new Network::MetricsServer(metrics);
+        if (!metricsServer->start(metricsPort))
+            return 1;
+    }
+
+    createObstacles();
+    createParticleColorLut();
+
+    // add event listeners
+    addSimulationControls();
+    createFluidInteractionListener();
+
+    // create gui
+    // createGui();
+
+    return 0;
+}
+
+void Application::createOptions()
+{
     options = Fluid::FluidOptions{
         numParticles : 1200,
         particleRadius : 5,
@@ -103,42 +237,243 @@ int Application::init()
 
         gravity : glm::vec2(0, 1500.0f),
 
+        useBoundingBox : true,
         boundingBox : Fluid::AABB{
             min : glm::vec2(0, 0),
             max : glm::vec2(windowWidth, windowHeight)
         },
         boudingBoxRestitution : 0.05f,
+        periodicX : false,
+        periodicY : false,
+
+        obstacleRestitution : 0.05f,
 
         pressureLimit : 200.0f,
         smoothingRadius : 50.0f,
         stiffness : 0.95e6f,
         desiredRestDensity : 0.000025f,
         particleMass : 0.045f,
-        viscosity : 0.13f,
+        viscosity : viscosity,
         surfaceTension : 0.0f,
         surfaceTensionThreshold : 0.0f,
 
         usePredictedPositions : true,
         numThreads : 4,
-    };
 
-    fluid = new Fluid::Fluid(options);
-    fluid->init();
+        useIncrementalGrid : true,
+        gridRebuildThreshold : 0.25f,
+        gridType : Fluid::GridType::DENSE_GRID,
+
+        solver : solver,
+        solverTolerance : 0.03f,
+        solverMinIterations : 2,
+        solverMaxIterations : 20,
+        artificialPressure : 0.1f,
+        flipCellSize : 30.0f,
+        flipBlend : 0.95f,
+        implicitViscosity : implicitViscosity,
+        viscosityTolerance : 0.001f,
+        viscosityMaxIterations : 50,
+    };
 
-    // add event listeners
-    addSimulationControls();
-    createFluidInteractionListener();
+    // pcisph and pbf don't compress the fluid past its rest density, so it has to be the density particles start at
+    if (solver != Fluid::SolverType::SPH_SOLVER)
+        options.desiredRestDensity = 0.00018f;
 
-    // create gui
-    // createGui();
+    // pbf is for interactive scenes, so takes a few cheap iterations rather than converging
+    if (solver == Fluid::SolverType::PBF_SOLVER)
+        options.solverMaxIterations = 4;
 
-    return 0;
+    // the flip solve is one linear system, so it is converged tightly
+    if (solver == Fluid::SolverType::FLIP_SOLVER)
+    {
+        options.solverTolerance = 0.001f;
+        options.solverMaxIterations = 200;
+    }
 }
 
 void Application::destroy()
 {
+    delete recorder;
+    delete server;
+    server = nullptr;
+    delete metricsServer;
+    metricsServer = nullptr;
+    delete obstacles;
+    obstacles = nullptr;
     delete renderer;
-    delete this;
+    renderer = nullptr;
+}
+
+int Application::verifyDeterminism(int numSteps)
+{
+    createOptions();
+
+    const int threadCounts[] = {1, 2, 3, 4, 7, 8};
+    const Fluid::GridType gridTypes[] = {Fluid::GridType::DENSE_GRID, Fluid::GridType::SPARSE_GRID};
+    const char *gridNames[] = {"dense", "sparse"};
+
+    // how often the state is hashed
+    const int hashInterval = 10;
+    bool identical = true;
+
+    for (int g = 0; g < 2; g++)
+    {
+        std::vector<uint64_t> reference;
+
+        for (int numThreads : threadCounts)
+        {
+            options.gridType = gridTypes[g];
+            options.numThreads = numThreads;
+
+            Fluid::Fluid fluid(options);
+            fluid.init();
+
+            // a pair of particles on top of each other so random directions are used,
+            // and an attractor so every force is exercised
+            fluid.getParticles()[1]->position = fluid.getParticles()[0]->position;
+            fluid.addAttractor(Fluid::FluidAttractor{options.initialCentre + glm::vec2(100, 0), 260.0f, 1.0e6f});
+
+            std::vector<uint64_t> hashes;
+            for (int step = 1; step <= numSteps; step++)
+            {
+                fluid.update(1.0f / 120.0f);
+
+                if (step % hashInterval == 0 || step == numSteps)
+                    hashes.push_back(fluid.getStateHash());
+            }
+
+            if (reference.empty())
+                reference = hashes;
+
+            // report the first step the run diverged from the single threaded run
+            int diverged = -1;
+            for (int i = 0; i < hashes.size() && diverged == -1; i++)
+            {
+                if (hashes[i] != reference[i])
+                    diverged = std::min((i + 1) * hashInterval, numSteps);
+            }
+
+            std::cout << "[DETERMINISM]: " << gridNames[g] << " grid, " << numThreads << " threads, hash " << std::hex << hashes.back() << std::dec;
+
+            if (diverged == -1)
+            {
+                std::cout << ", identical" << std::endl;
+            }
+            else
+            {
+                std::cout << ", diverged by step " << diverged << std::endl;
+                identical = false;
+            }
+        }
+    }
+
+    std::cout << "[DETERMINISM]: " << (identical ? "passed" : "failed") << std::endl;
+    return identical ? 0 : 1;
+}
+
+int Application::benchmark(int numSteps, int numParticles, float dt, const std::string &referencePath)
+{
+    createOptions();
+    options.numParticles = numParticles;
+    options.numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    Fluid::Fluid fluid(options);
+    fluid.init();
+
+    const char *solverNames[] = {"sph", "pcisph", "pbf", "flip"};
+    std::cout << "[BENCHMARK]: " << numParticles << " particles, " << numSteps << " steps of " << dt << "s, " << options.numThreads << " threads, " << solverNames[options.solver] << " solver, "
+              << (options.implicitViscosity ? "implicit" : "explicit") << " viscosity " << options.viscosity << std::endl;
+    std::cout << "[BENCHMARK]: compute " << Fluid::SCALAR_NAME << ", forces stored as " << Fluid::COLD_STORAGE_NAME
+              << ", " << sizeof(Fluid::Particle) << " bytes per particle, " << sizeof(Fluid::ParticleNeighbour) << " bytes per neighbour" << std::endl;
+
+    double phaseSeconds[Fluid::NUM_PHASES] = {};
+    int solverIterations = 0;
+    int viscosityIterations = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int step = 0; step < numSteps; step++)
+    {
+        fluid.update(dt);
+
+        const Fluid::FluidStats &stats = fluid.getStats();
+        for (int i = 0; i < Fluid::NUM_PHASES; i++)
+            phaseSeconds[i] += stats.phaseSeconds[i];
+
+        solverIterations += stats.solverIterations;
+        viscosityIterations += stats.viscosityIterations;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const char *phaseNames[] = {"pre solve", "grid", "neighbours", "density pressure", "forces", "viscosity solve", "pressure solve", "apply forces"};
+    // larger steps are only worth it if they cost less than the smaller steps they replace
+    std::cout << "[BENCHMARK]: " << seconds * 1000.0 / numSteps << " ms per step, " << numSteps * dt / seconds << " simulated seconds per second" << std::endl;
+
+    if (solverIterations > 0)
+        std::cout << "[BENCHMARK]: " << static_cast<float>(solverIterations) / numSteps << " solver iterations per step, " << fluid.getDiagnostics().meanDensityError * 100.0f << "% density error" << std::endl;
+    if (viscosityIterations > 0)
+        std::cout << "[BENCHMARK]: " << static_cast<float>(viscosityIterations) / numSteps << " viscosity iterations per step" << std::endl;
+    for (int i = 0; i < Fluid::NUM_PHASES; i++)
+        std::cout << "[BENCHMARK]:     " << phaseNames[i] << " " << phaseSeconds[i] * 1000.0 / numSteps << " ms" << std::endl;
+
+    if (referencePath.empty())
+        return 0;
+
+    std::vector<Fluid::Particle *> &particles = fluid.getParticles();
+
+    // positions are kept as doubles so any build can be compared against any other
+    std::ifstream referenceFile(referencePath, std::ios::binary);
+    if (!referenceFile)
+    {
+        std::ofstream file(referencePath, std::ios::binary);
+        uint64_t count = particles.size();
+        file.write((const char *)&count, sizeof(count));
+
+        for (Fluid::Particle *p : particles)
+        {
+            double position[2] = {(double)p->position.x, (double)p->position.y};
+            file.write((const char *)position, sizeof(position));
+        }
+
+        if (!file)
+        {
+            std::cout << "[BENCHMARK]: Couldn't write reference " << referencePath << std::endl;
+            return 1;
+        }
+
+        std::cout << "[BENCHMARK]: Wrote reference " << referencePath << std::endl;
+        return 0;
+    }
+
+    uint64_t count = 0;
+    referenceFile.read((char *)&count, sizeof(count));
+    if (!referenceFile || count != particles.size())
+    {
+        std::cout << "[BENCHMARK]: Reference " << referencePath << " doesn't match this run" << std::endl;
+        return 1;
+    }
+
+    double sumSqrError = 0.0;
+    double maxError = 0.0;
+    for (Fluid::Particle *p : particles)
+    {
+        double position[2];
+        referenceFile.read((char *)position, sizeof(position));
+
+        double error = std::hypot(p->position.x - position[0], p->position.y - position[1]);
+        sumSqrError += error * error;
+        maxError = std::max(maxError, error);
+    }
+
+    if (!referenceFile)
+    {
+        std::cout << "[BENCHMARK]: Reference " << referencePath << " is truncated" << std::endl;
+        return 1;
+    }
+
+    std::cout << "[BENCHMARK]: position error against reference, rms " << std::sqrt(sumSqrError / count) << ", max " << maxError << std::endl;
+    return 0;
 }
 
 void Application::update(float dt)
@@ -147,7 +482,147 @@ void Application::update(float dt)
     {
         stepSimulation = false;
         fluid->update(dt);
+
+        if (recorder != nullptr)
+            recorder->record(fluid->getParticles());
+
+        if (server != nullptr)
+            server->submit(fluid->getParticles());
+
+        if (metricsServer != nullptr)
+            updateMetrics();
+
+        // nobody is watching a headless run, so stop rather than keep simulating garbage
+        auto watchdog = fluid->getWatchdog();
+        if (headless && watchdog != nullptr && watchdog->hasFailed())
+        {
+            std::cout << std::endl
+                      << "[WATCHDOG]: couldn't recover, exiting" << std::endl;
+            state = ApplicationState::EXIT;
+        }
+    }
+}
+
+void Application::createMetrics()
+{
+    const char *phaseNames[Fluid::NUM_PHASES] = {"pre_solve", "grid", "neighbours", "density_pressure", "forces", "viscosity_solve", "pressure_solve", "apply_forces"};
+    const std::vector<double> secondsBounds = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1};
+
+    for (int i = 0; i < Fluid::NUM_PHASES; i++)
+    {
+        phaseMetrics[i] = metrics.addHistogram(std::string("fluid_phase_") + phaseNames[i] + "_seconds", std::string("Time spent in the ") + phaseNames[i] + " phase of a step.", secondsBounds);
     }
+
+    stepMetric = metrics.addHistogram("fluid_step_seconds", "Time spent in a whole step.", secondsBounds);
+    stepsMetric = metrics.addCounter("fluid_steps_total", "Steps simulated.");
+    particlesMetric = metrics.addGauge("fluid_particles", "Number of particles.");
+
+    neighboursMetric = metrics.addHistogram("fluid_neighbours", "Neighbours per particle, sampled every few steps.", {0, 5, 10, 15, 20, 30, 40, 60, 80, 120});
+    occupiedCellsMetric = metrics.addGauge("fluid_grid_occupied_cells", "Grid cells containing particles, sampled every few steps.");
+    meanOccupancyMetric = metrics.addGauge("fluid_grid_mean_occupancy", "Mean particles per occupied grid cell, sampled every few steps.");
+    maxOccupancyMetric = metrics.addGauge("fluid_grid_max_occupancy", "Most particles in a grid cell, sampled every few steps.");
+    gridChurnMetric = metrics.addGauge("fluid_grid_churn", "Fraction of particles that changed grid cell during the last step.");
+    solverIterationsMetric = metrics.addGauge("fluid_solver_iterations", "Pressure solver iterations during the last step.");
+    viscosityIterationsMetric = metrics.addGauge("fluid_viscosity_iterations", "Implicit viscosity solver iterations during the last step.");
+
+    kineticEnergyMetric = metrics.addGauge("fluid_kinetic_energy", "Total kinetic energy.");
+    potentialEnergyMetric = metrics.addGauge("fluid_potential_energy", "Total gravitational potential energy.");
+    maxSpeedMetric = metrics.addGauge("fluid_max_speed", "Fastest particle speed.");
+    densityErrorMetric = metrics.addGauge("fluid_density_error", "Mean density deviation from the rest density, as a fraction of it.");
+    maxDensityErrorMetric = metrics.addGauge("fluid_max_density_error", "Largest density deviation from the rest density, as a fraction of it.");
+    watchdogRollbacksMetric = metrics.addCounter("fluid_watchdog_rollbacks_total", "Times the watchdog rolled the fluid back after a blow up.");
+    pressureClampMetric = metrics.addCounter("fluid_pressure_clamp_hits_total", "Particles whose pressure was clamped to the pressure limit.");
+
+    allocationsMetric = metrics.addCounter("process_allocations_total", "Heap allocations made by the process.");
+    recordingDroppedMetric = metrics.addCounter("fluid_recording_dropped_frames_total", "Frames dropped by the trajectory recorder.");
+    streamDroppedMetric = metrics.addCounter("fluid_stream_dropped_frames_total", "Frames dropped for stream viewers.");
+
+    lastAllocations = Utility::getAllocationCount();
+}
+
+void Application::updateMetrics()
+{
+    auto &stats = fluid->getStats();
+    auto &particles = fluid->getParticles();
+
+    float stepSeconds = 0.0f;
+    for (int i = 0; i < Fluid::NUM_PHASES; i++)
+    {
+        phaseMetrics[i]->observe(stats.phaseSeconds[i]);
+        stepSeconds += stats.phaseSeconds[i];
+    }
+
+    stepMetric->observe(stepSeconds);
+    stepsMetric->add();
+    particlesMetric->set(particles.size());
+    gridChurnMetric->set(stats.gridChurn);
+    solverIterationsMetric->set(stats.solverIterations);
+    viscosityIterationsMetric->set(stats.viscosityIterations);
+
+    auto &diagnostics = fluid->getDiagnostics();
+    kineticEnergyMetric->set(diagnostics.kineticEnergy);
+    potentialEnergyMetric->set(diagnostics.potentialEnergy);
+    maxSpeedMetric->set(diagnostics.maxSpeed);
+    densityErrorMetric->set(diagnostics.meanDensityError);
+    maxDensityErrorMetric->set(diagnostics.maxDensityError);
+    pressureClampMetric->add(diagnostics.pressureClampHits);
+
+    // the watchdog is replaced when the fluid is reset
+    auto watchdog = fluid->getWatchdog();
+    int watchdogEvents = watchdog == nullptr ? 0 : watchdog->getEvents().size();
+    if (watchdogEvents > lastWatchdogEvents)
+        watchdogRollbacksMetric->add(watchdogEvents - lastWatchdogEvents);
+    lastWatchdogEvents = watchdogEvents;
+
+    uint64_t allocations = Utility::getAllocationCount();
+    allocationsMetric->add(allocations - lastAllocations);
+    lastAllocations = allocations;
+
+    // the recorder is replaced every time recording starts
+    int recordingDropped = recorder == nullptr ? 0 : recorder->getDroppedFrames();
+    if (recordingDropped > lastRecordingDropped)
+        recordingDroppedMetric->add(recordingDropped - lastRecordingDropped);
+    lastRecordingDropped = recordingDropped;
+
+    int streamDropped = server == nullptr ? 0 : server->getDroppedFrames();
+    streamDroppedMetric->add(streamDropped - lastStreamDropped);
+    lastStreamDropped = streamDropped;
+
+    if (metricsStep++ % METRICS_SAMPLE_INTERVAL != 0)
+        return;
+
+    // count locally and observe each distinct count once, rather than an atomic update per particle
+    std::vector<uint64_t> neighbourCounts;
+    for (auto p : particles)
+    {
+        if (p->neighbours.size() >= neighbourCounts.size())
+            neighbourCounts.resize(p->neighbours.size() + 1, 0);
+
+        neighbourCounts[p->neighbours.size()]++;
+    }
+
+    for (int i = 0; i < neighbourCounts.size(); i++)
+    {
+        if (neighbourCounts[i] > 0)
+            neighboursMetric->observe(i, neighbourCounts[i]);
+    }
+
+    int occupiedCells = 0;
+    int occupiedParticles = 0;
+    int maxOccupancy = 0;
+    fluid->forEachGridCell([&](const std::pair<int, int> &, const std::vector<Fluid::Particle *> &cell)
+                           {
+                               if (cell.empty())
+                                   return;
+
+                               occupiedCells++;
+                               occupiedParticles += cell.size();
+                               maxOccupancy = std::max(maxOccupancy, static_cast<int>(cell.size()));
+                           });
+
+    occupiedCellsMetric->set(occupiedCells);
+    meanOccupancyMetric->set(occupiedCells == 0 ? 0.0 : (double)occupiedParticles / occupiedCells);
+    maxOccupancyMetric->set(maxOccupancy);
 }
 
 void Application::render(bool clear)
@@ -162,65 +637,90 @@ void Application::render(bool clear)
     }
 
     // draw particles
-    auto particles = fluid->getParticles();
-    int numParticles = particles.size();
-
-    Rendering::Circle circles[numParticles];
-    Rendering::Color colors[numParticles];
-
-    for (int i = 0; i < numParticles; i++)
-    {
-        auto p = particles[i];
-        circles[i] = Rendering::Circle{p->position, options.particleRadius};
-        colors[i] = getParticleColor(p);
-    }
+    extractRenderData();
+    renderer->circles(renderCircles.data(), renderColors.data(), renderCircles.size());
 
-    renderer->shaderCircles(circles, colors, numParticles);
+    if (enableObstacles)
+        renderObstacles();
 
     // draw attractor
     if (isAttractorActive)
     {
-        renderer->circle(Rendering::Circle{attractor->position, attractor->radius},
+        renderer->circle(Rendering::Circle{attractor.position, attractor.radius},
                          Rendering::Color{0, 255, 0, 255}, Rendering::RenderType::STROKE);
     }
 
     if (Globals::DEBUG_MODE)
     {
+        auto debugDraw = renderer->getDebugDraw();
+
         // draw bounding box
         glm::vec2 bbPosition(options.boundingBox.min.x, options.boundingBox.min.y);
         float bbW = options.boundingBox.max.x - options.boundingBox.min.x;
         float bbH = options.boundingBox.max.y - options.boundingBox.min.y;
 
-        renderer->rect(Rendering::Rect{bbPosition, bbW, bbH},
-                       Rendering::Color{0, 255, 0, 255}, Rendering::RenderType::STROKE);
+        debugDraw->rect(Rendering::Rect{bbPosition, bbW, bbH}, Rendering::Color{0, 255, 0, 255});
+
+        // draw grid, as an occupancy heatmap if enabled
+        auto cellSize = fluid->getCellSize();
+        int maxOccupancy = 1;
 
-        // draw grid
-        for (auto &kv : fluid->getGrid())
+        if (enableOccupancyHeatmap)
         {
-            auto key = kv.first;
-            auto particles = kv.second;
+            fluid->forEachGridCell([&](const std::pair<int, int> &key, const std::vector<Fluid::Particle *> &particles)
+                                   { maxOccupancy = std::max(maxOccupancy, static_cast<int>(particles.size())); });
+        }
+
+        fluid->forEachGridCell([&](const std::pair<int, int> &key, const std::vector<Fluid::Particle *> &particles)
+                               {
+                                   glm::vec2 position(key.first * cellSize.x, key.second * cellSize.y);
+                                   if (options.useBoundingBox)
+                                       position += bbPosition;
 
-            glm::vec2 position(key.first * options.smoothingRadius, key.second * options.smoothingRadius);
-            position += bbPosition;
+                                   Rendering::Rect rect{position, cellSize.x, cellSize.y};
+
+                                   if (enableOccupancyHeatmap && !particles.empty())
+                                   {
+                                       // blue for sparse cells through to red for the fullest cell
+                                       float ratio = static_cast<float>(particles.size()) / maxOccupancy;
+                                       debugDraw->rect(rect, Rendering::Color{static_cast<int>(255 * ratio), 0, static_cast<int>(255 * (1 - ratio)), 110}, Rendering::RenderType::FILL);
+                                   }
+
+                                   debugDraw->rect(rect, Rendering::Color{255, 0, 0, 75});
+                               });
+
+        // draw the region each thread searches for neighbours in
+        if (enableThreadPartitions)
+        {
+            const Rendering::Color partitionColors[] = {{255, 200, 0, 50}, {0, 220, 255, 50}, {255, 0, 200, 50}, {120, 255, 0, 50}};
 
-            float w = options.smoothingRadius;
-            float h = options.smoothingRadius;
+            std::vector<Fluid::AABB> partitions;
+            fluid->getThreadPartitions(partitions);
 
-            renderer->rect(Rendering::Rect{position, w, h},
-                           Rendering::Color{255, 0, 0, 75}, Rendering::RenderType::STROKE);
+            for (int i = 0; i < partitions.size(); i++)
+            {
+                auto &partition = partitions[i];
+                Rendering::Rect rect{partition.min, partition.max.x - partition.min.x, partition.max.y - partition.min.y};
+
+                Rendering::Color color = partitionColors[i % 4];
+                debugDraw->rect(rect, color, Rendering::RenderType::FILL);
+
+                color.a = 255;
+                debugDraw->rect(rect, color);
+            }
         }
 
         // draw neighbours of particle 0
         auto p = fluid->getParticles()[0];
-        auto neighbours = p->neighbours;
+        auto &neighbours = p->neighbours;
         // std::cout << "particle 0 neighbours count: " << neighbours.size() << std::endl;
 
-        for (auto n : neighbours)
+        for (auto &n : neighbours)
         {
             glm::vec2 nPosition = n.particle->position;
             nPosition += bbPosition;
 
-            renderer->line(p->position, nPosition, Rendering::Color{255, 255, 255, 255});
+            debugDraw->line(p->position, nPosition, Rendering::Color{255, 255, 255, 255});
         }
     }
 
@@ -228,9 +728,67 @@ void Application::render(bool clear)
     renderer->present();
 }
 
-Rendering::Color Application::getParticleColor(Fluid::Particle *particle)
+void Application::extractRenderData()
+{
+    int numParticles = fluid->getParticles().size();
+
+    // resizing keeps the capacity so after the first frame this doesn't allocate
+    renderCircles.resize(numParticles);
+    renderColors.resize(numParticles);
+
+    int numThreads = std::max(1, std::min(options.numThreads, numParticles / 1000));
+
+    std::thread threads[numThreads];
+    int perThread = (numParticles + numThreads - 1) / numThreads;
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        int start = i * perThread;
+        int end = std::min(start + perThread - 1, numParticles - 1);
+
+        threads[i] = std::thread(&Application::extractRenderDataThread, this, start, end);
+    }
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads[i].join();
+    }
+}
+
+void Application::extractRenderDataThread(int startingParticle, int endingParticle)
 {
-    const float v = glm::dot(particle->velocity, particle->velocity);
+    auto &particles = fluid->getParticles();
+
+    const float radius = fluid->getOptions().particleRadius;
+    const float lutScale = (PARTICLE_COLOR_LUT_SIZE - 1) / (PARTICLE_COLOR_LUT_MAX_SPEED * PARTICLE_COLOR_LUT_MAX_SPEED);
+
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        float speedSqr = glm::dot(p->velocity, p->velocity);
+
+        // clamped before casting, blown up particles are nan, infinite or too fast to fit in an int
+        float lutIndex = speedSqr * lutScale;
+        int colorIndex = (lutIndex >= 0 && lutIndex < PARTICLE_COLOR_LUT_SIZE - 1) ? static_cast<int>(lutIndex) : PARTICLE_COLOR_LUT_SIZE - 1;
+
+        renderCircles[i] = Rendering::Circle{p->position, radius};
+        renderColors[i] = particleColorLut[colorIndex];
+    }
+}
+
+void Application::createParticleColorLut()
+{
+    float maxSpeedSqr = PARTICLE_COLOR_LUT_MAX_SPEED * PARTICLE_COLOR_LUT_MAX_SPEED;
+
+    for (int i = 0; i < PARTICLE_COLOR_LUT_SIZE; i++)
+    {
+        particleColorLut[i] = getParticleColor(maxSpeedSqr * i / (PARTICLE_COLOR_LUT_SIZE - 1));
+    }
+}
+
+Rendering::Color Application::getParticleColor(float speedSqr)
+{
+    const float v = speedSqr;
 
     const float steps[] = {std::pow(60.0f, 2), std::pow(200.0f, 2), std::pow(400.0f, 2), std::pow(700.0f, 2)};
     const Rendering::Color colors[] = {{33, 55, 222, 255},
@@ -285,13 +843,7 @@ void Application::renderPerPixelDensity(unsigned int skip)
             auto c = Rendering::blend(bg, fg);
             // std::cout << c.r << ", " << c.g << ", " << c.b << ", " << c.a << std::endl;
 
-            for (int px = 0; px < skip; px++)
-            {
-                for (int py = 0; py < skip; py++)
-                {
-                    renderer->pixel(position + glm::vec2(px, py), c);
-                }
-            }
+            renderer->pixelRect(i, j, skip, skip, c);
         }
     }
 
@@ -301,9 +853,9 @@ void Application::renderPerPixelDensity(unsigned int skip)
 void Application::addSimulationControls()
 {
     renderer->on(Rendering::RendererEventType::KEY_UP,
-                 [&](Rendering::RendererEvent event)
+                 [&](const Rendering::RendererEvent &event)
                  {
-                     auto keyCode = *static_cast<Utility::KeyCode *>(event.data);
+                     auto keyCode = std::get<Utility::KeyCode>(event.data);
 
                      if (keyCode == Utility::KeyCode::KEY_SPACE)
                      {
@@ -312,9 +864,9 @@ void Application::addSimulationControls()
                  });
 
     renderer->on(Rendering::RendererEventType::KEY_UP,
-                 [&](Rendering::RendererEvent event)
+                 [&](const Rendering::RendererEvent &event)
                  {
-                     auto keyCode = *static_cast<Utility::KeyCode *>(event.data);
+                     auto keyCode = std::get<Utility::KeyCode>(event.data);
 
                      if (keyCode == Utility::KeyCode::KEY_RIGHT)
                      {
@@ -326,15 +878,79 @@ void Application::addSimulationControls()
 
                          fluid = new Fluid::Fluid(options);
                          fluid->init();
+                         fluid->setObstacles(enableObstacles ? obstacles : nullptr);
+
+                         if (!publishName.empty())
+                             fluid->startPublishing(publishName);
+
+                         if (useWatchdog)
+                             fluid->enableWatchdog();
+
+                         // the log restarts with the fluid
+                         if (!diagnosticsPath.empty())
+                             fluid->getDiagnosticsLog().startCsv(diagnosticsPath);
                      }
                      else if (keyCode == Utility::KeyCode::KEY_D)
                      {
                          Globals::DEBUG_MODE = !Globals::DEBUG_MODE;
                      }
+                     else if (keyCode == Utility::KeyCode::KEY_H)
+                     {
+                         enableOccupancyHeatmap = !enableOccupancyHeatmap;
+                     }
+                     else if (keyCode == Utility::KeyCode::KEY_N)
+                     {
+                         enableThreadPartitions = !enableThreadPartitions;
+                     }
                      else if (keyCode == Utility::KeyCode::KEY_C)
                      {
                          enablePerPixelDensity = !enablePerPixelDensity;
                      }
+                     else if (keyCode == Utility::KeyCode::KEY_K)
+                     {
+                         if (fluid->saveCheckpoint("checkpoint.fluid"))
+                             std::cout << "[CHECKPOINT]: saving to checkpoint.fluid" << std::endl;
+                         else
+                             std::cout << "[CHECKPOINT]: still saving last checkpoint" << std::endl;
+                     }
+                     else if (keyCode == Utility::KeyCode::KEY_L)
+                     {
+                         if (fluid->loadCheckpoint("checkpoint.fluid"))
+                         {
+                             options = fluid->getOptions();
+                             isAttractorActive = false;
+                             std::cout << "[CHECKPOINT]: loaded checkpoint.fluid" << std::endl;
+                         }
+                         else
+                         {
+                             std::cout << "[CHECKPOINT]: failed to load checkpoint.fluid" << std::endl;
+                         }
+                     }
+                     else if (keyCode == Utility::KeyCode::KEY_T)
+                     {
+                         toggleRecording();
+                     }
+                     else if (keyCode == Utility::KeyCode::KEY_E)
+                     {
+                         if (fluid->getDiagnosticsLog().saveCsv("diagnostics.csv"))
+                             std::cout << "[DIAGNOSTICS]: saved the last " << fluid->getDiagnosticsLog().getSize() << " steps to diagnostics.csv" << std::endl;
+                         else
+                             std::cout << "[DIAGNOSTICS]: failed to save diagnostics.csv" << std::endl;
+                     }
+                     else if (keyCode == Utility::KeyCode::KEY_B)
+                     {
+                         // cycle batched circles -> shader circles -> software circles -> software metaballs
+                         auto backend = static_cast<Rendering::CirclesBackend>((renderer->getCirclesBackend() + 1) % 4);
+                         renderer->setCirclesBackend(backend);
+
+                         const char *names[] = {"batched circles", "shader circles", "software circles", "software metaballs"};
+                         std::cout << "[RENDERER]: " << names[backend] << std::endl;
+                     }
+                     else if (keyCode == Utility::KeyCode::KEY_O)
+                     {
+                         enableObstacles = !enableObstacles;
+                         fluid->setObstacles(enableObstacles ? obstacles : nullptr);
+                     }
                      else if (keyCode == Utility::KeyCode::KEY_Y)
                      {
                          options.usePredictedPositions = !options.usePredictedPositions;
@@ -402,51 +1018,112 @@ void Application::createFluidInteractionListener()
     float radius = 260.0f;
     float strength = options.stiffness * (options.stiffness * 0.036f);
 
-    attractor = new Fluid::FluidAttractor{
+    attractor = Fluid::FluidAttractor{
         position : glm::vec2(0, 0),
         radius : radius,
         strength : strength,
     };
 
     renderer->on(Rendering::RendererEventType::MOUSE_DOWN,
-                 [&, strength](Rendering::RendererEvent event)
+                 [&, strength](const Rendering::RendererEvent &event)
                  {
-                     auto mouseButton = *static_cast<Utility::MouseButton *>(event.data);
+                     auto mouseButton = std::get<Utility::MouseButton>(event.data);
 
                      if (mouseButton == Utility::MouseButton::MOUSE_LEFT && !isAttractorActive)
                      {
                          isAttractorActive = true;
-                         attractor->strength = strength;
-                         fluid->addAttractor(attractor);
+                         attractor.strength = strength;
+                         attractorHandle = fluid->addAttractor(attractor);
                      }
                      else if (mouseButton == Utility::MouseButton::MOUSE_RIGHT && !isAttractorActive)
                      {
                          isAttractorActive = true;
-                         attractor->strength = -strength;
-                         fluid->addAttractor(attractor);
+                         attractor.strength = -strength;
+                         attractorHandle = fluid->addAttractor(attractor);
                      }
                  });
 
     renderer->on(Rendering::RendererEventType::MOUSE_UP,
-                 [&](Rendering::RendererEvent event)
+                 [&](const Rendering::RendererEvent &event)
                  {
-                     auto mouseButton = *static_cast<Utility::MouseButton *>(event.data);
+                     auto mouseButton = std::get<Utility::MouseButton>(event.data);
 
                      if (mouseButton == Utility::MouseButton::MOUSE_LEFT || mouseButton == Utility::MouseButton::MOUSE_RIGHT)
                      {
                          isAttractorActive = false;
-                         fluid->removeAttractor(attractor);
+                         fluid->removeAttractor(attractorHandle);
                      }
                  });
 
     renderer->on(Rendering::RendererEventType::MOUSE_MOVE,
-                 [&](Rendering::RendererEvent event)
+                 [&](const Rendering::RendererEvent &event)
                  {
-                     mousePos = *static_cast<glm::vec2 *>(event.data);
-                     attractor->position = mousePos;
+                     mousePos = std::get<glm::vec2>(event.data);
+                     attractor.position = mousePos;
+
+                     auto activeAttractor = fluid->getAttractor(attractorHandle);
+                     if (activeAttractor != nullptr)
+                         activeAttractor->position = mousePos;
                  });
 }
 
+void Application::createObstacles()
+{
+    // obstacles are baked at the particle radius so collisions stay smooth
+    obstacles = new Fluid::ObstacleField(options.boundingBox, options.particleRadius);
+
+    // ramp on the left
+    obstacles->addPolygon({glm::vec2(0, windowHeight * 0.45f),
+                           glm::vec2(windowWidth * 0.35f, windowHeight * 0.7f),
+                           glm::vec2(windowWidth * 0.35f, windowHeight * 0.75f),
+                           glm::vec2(0, windowHeight * 0.75f)});
+
+    // ball in the middle
+    obstacles->addCircle(Fluid::ObstacleCircle{glm::vec2(windowWidth * 0.65f, windowHeight * 0.7f), 80.0f});
+
+    obstacles->bake(options.numThreads);
+}
+
+void Application::renderObstacles()
+{
+    const Rendering::Color color{120, 120, 120, 255};
+
+    for (auto &vertices : obstacles->getPolygons())
+    {
+        renderer->polygon(vertices, color);
+    }
+
+    for (auto &c : obstacles->getCircles())
+    {
+        renderer->circle(Rendering::Circle{c.centre, c.radius}, color);
+    }
+}
+
+void Application::toggleRecording()
+{
+    if (recorder != nullptr)
+    {
+        recorder->close();
+        std::cout << "[RECORDING]: stopped, " << recorder->getRecordedFrames() << " frames recorded, "
+                  << recorder->getDroppedFrames() << " dropped" << std::endl;
+
+        delete recorder;
+        recorder = nullptr;
+        return;
+    }
+
+    // record every other step
+    recorder = new Fluid::TrajectoryRecorder("trajectory.fluidtrj", options.boundingBox, 4000.0f, 2);
+    if (!recorder->open())
+    {
+        delete recorder;
+        recorder = nullptr;
+        return;
+    }
+
+    std::cout << "[RECORDING]: started, writing to trajectory.fluidtrj" << std::endl;
+}
+
 void Application::createGui()
 {
     int guiWidth = 200;
@@ -0,0 +1,124 @@
+#include "../../include/Fluid/Checkpoint.h"
+
+#include <cstring>
+
+namespace
+{
+    uint64_t alignSection(uint64_t offset)
+    {
+        return (offset + Fluid::Checkpoint::SECTION_ALIGNMENT - 1) & ~(Fluid::Checkpoint::SECTION_ALIGNMENT - 1);
+    }
+
+    // written so a corrupt offset or count can't overflow and wrap back inside the file, itemSize must not be 0
+    bool sectionFits(uint64_t offset, uint64_t itemSize, uint64_t count, uint64_t size)
+    {
+        return offset <= size && count <= (size - offset) / itemSize;
+    }
+}
+
+void Fluid::Checkpoint::write(std::vector<char> &buffer, const FluidOptions &options, const std::vector<Particle *> &particles, const std::vector<FluidAttractor> &attractors)
+{
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.headerSize = sizeof(Header);
+
+    header.optionsOffset = alignSection(sizeof(Header));
+    header.optionsSize = sizeof(FluidOptions);
+
+    header.particlesOffset = alignSection(header.optionsOffset + header.optionsSize);
+    header.particleSize = sizeof(ParticleRecord);
+    header.numParticles = particles.size();
+
+    header.attractorsOffset = alignSection(header.particlesOffset + header.particleSize * header.numParticles);
+    header.attractorSize = sizeof(FluidAttractor);
+    header.numAttractors = attractors.size();
+
+    header.fileSize = header.attractorsOffset + header.attractorSize * header.numAttractors;
+
+    // padding between sections is zeroed so the checksum is stable
+    buffer.assign(header.fileSize, 0);
+    char *data = buffer.data();
+
+    std::memcpy(data + header.optionsOffset, &options, sizeof(FluidOptions));
+
+    ParticleRecord *outParticles = reinterpret_cast<ParticleRecord *>(data + header.particlesOffset);
+    for (size_t i = 0; i < particles.size(); i++)
+    {
+        auto p = particles[i];
+        outParticles[i] = ParticleRecord{p->position, p->velocity, p->predictedPosition, p->radius, p->mass, p->density, p->pressure};
+    }
+
+    if (attractors.size() > 0)
+        std::memcpy(data + header.attractorsOffset, attractors.data(), header.attractorSize * header.numAttractors);
+
+    header.checksum = checksum(data + sizeof(Header), header.fileSize - sizeof(Header));
+    std::memcpy(data, &header, sizeof(Header));
+}
+
+const Fluid::Checkpoint::Header *Fluid::Checkpoint::validate(const char *data, size_t size)
+{
+    if (data == nullptr || size < sizeof(Header))
+        return nullptr;
+
+    auto header = reinterpret_cast<const Header *>(data);
+
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION || header->headerSize != sizeof(Header))
+        return nullptr;
+
+    if (header->optionsSize != sizeof(FluidOptions) || header->particleSize != sizeof(ParticleRecord) || header->attractorSize != sizeof(FluidAttractor))
+        return nullptr;
+
+    // sections must be inside the file
+    if (header->fileSize != size ||
+        !sectionFits(header->optionsOffset, header->optionsSize, 1, size) ||
+        !sectionFits(header->particlesOffset, header->particleSize, header->numParticles, size) ||
+        !sectionFits(header->attractorsOffset, header->attractorSize, header->numAttractors, size))
+        return nullptr;
+
+    if (checksum(data + sizeof(Header), size - sizeof(Header)) != header->checksum)
+        return nullptr;
+
+    return header;
+}
+
+const Fluid::FluidOptions *Fluid::Checkpoint::getOptions(const char *data)
+{
+    auto header = reinterpret_cast<const Header *>(data);
+    return reinterpret_cast<const FluidOptions *>(data + header->optionsOffset);
+}
+
+const Fluid::Checkpoint::ParticleRecord *Fluid::Checkpoint::getParticles(const char *data)
+{
+    auto header = reinterpret_cast<const Header *>(data);
+    return reinterpret_cast<const ParticleRecord *>(data + header->particlesOffset);
+}
+
+const Fluid::FluidAttractor *Fluid::Checkpoint::getAttractors(const char *data)
+{
+    auto header = reinterpret_cast<const Header *>(data);
+    return reinterpret_cast<const FluidAttractor *>(data + header->attractorsOffset);
+}
+
+uint64_t Fluid::Checkpoint::checksum(const char *data, size_t size)
+{
+    // hashes 8 bytes at a time so validating large checkpoints stays fast
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+
+    for (; i < size; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,76 @@
+#include "../../include/Fluid/CheckpointWriter.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+Fluid::CheckpointWriter::CheckpointWriter()
+{
+}
+
+Fluid::CheckpointWriter::~CheckpointWriter()
+{
+    wait();
+}
+
+std::vector<char> &Fluid::CheckpointWriter::getBuffer()
+{
+    return buffer;
+}
+
+bool Fluid::CheckpointWriter::start(const std::string &path)
+{
+    if (isWriting())
+        return false;
+
+    // join last finished write
+    wait();
+
+    writing = true;
+    thread = std::thread(&CheckpointWriter::writeThread, this, path);
+
+    return true;
+}
+
+bool Fluid::CheckpointWriter::isWriting()
+{
+    return writing;
+}
+
+void Fluid::CheckpointWriter::wait()
+{
+    if (thread.joinable())
+        thread.join();
+}
+
+void Fluid::CheckpointWriter::writeThread(std::string path)
+{
+    std::string tempPath = path + ".tmp";
+
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    file.close();
+
+    if (!file)
+    {
+        std::cout << "Failed to write checkpoint to " << tempPath << "." << std::endl;
+    }
+    else
+    {
+        // replaces the old checkpoint in one step, so there is always a complete checkpoint at path
+#ifdef _WIN32
+        bool moved = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        bool moved = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+
+        if (!moved)
+            std::cout << "Failed to move checkpoint to " << path << "." << std::endl;
+    }
+
+    writing = false;
+}
@@ -0,0 +1,104 @@
+#include "../../include/Fluid/DiagnosticsLog.h"
+
+Fluid::DiagnosticsLog::DiagnosticsLog(int capacity) : capacity(capacity)
+{
+    entries.reserve(capacity);
+}
+
+Fluid::DiagnosticsLog::~DiagnosticsLog()
+{
+    stopCsv();
+}
+
+void Fluid::DiagnosticsLog::push(const FluidDiagnostics &diagnostics)
+{
+    if (entries.size() < capacity)
+    {
+        entries.push_back(diagnostics);
+    }
+    else
+    {
+        // overwrite the oldest entry
+        entries[start] = diagnostics;
+        start = (start + 1) % capacity;
+    }
+
+    if (csv.is_open())
+        writeCsvRow(csv, diagnostics);
+}
+
+void Fluid::DiagnosticsLog::clear()
+{
+    entries.clear();
+    start = 0;
+}
+
+int Fluid::DiagnosticsLog::getSize()
+{
+    return entries.size();
+}
+
+int Fluid::DiagnosticsLog::getCapacity()
+{
+    return capacity;
+}
+
+const Fluid::FluidDiagnostics &Fluid::DiagnosticsLog::get(int i)
+{
+    return entries[(start + i) % entries.size()];
+}
+
+bool Fluid::DiagnosticsLog::startCsv(const std::string &path)
+{
+    stopCsv();
+
+    csv.open(path, std::ios::out | std::ios::trunc);
+    if (!csv.is_open())
+        return false;
+
+    writeCsvHeader(csv);
+    return true;
+}
+
+void Fluid::DiagnosticsLog::stopCsv()
+{
+    if (csv.is_open())
+        csv.close();
+}
+
+bool Fluid::DiagnosticsLog::isWritingCsv()
+{
+    return csv.is_open();
+}
+
+bool Fluid::DiagnosticsLog::saveCsv(const std::string &path)
+{
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    writeCsvHeader(out);
+    for (int i = 0; i < getSize(); i++)
+    {
+        writeCsvRow(out, get(i));
+    }
+
+    return out.good();
+}
+
+void Fluid::DiagnosticsLog::writeCsvHeader(std::ostream &out)
+{
+    out << "step,dt,kinetic_energy,potential_energy,max_speed,mean_density_error,max_density_error,pressure_clamp_hits\n";
+}
+
+void Fluid::DiagnosticsLog::writeCsvRow(std::ostream &out, const FluidDiagnostics &diagnostics)
+{
+    out << diagnostics.step << ","
+        << diagnostics.dt << ","
+        << diagnostics.kineticEnergy << ","
+        << diagnostics.potentialEnergy << ","
+        << diagnostics.maxSpeed << ","
+        << diagnostics.meanDensityError << ","
+        << diagnostics.maxDensityError << ","
+        << diagnostics.pressureClampHits << "\n";
+}
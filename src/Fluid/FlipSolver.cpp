@@ -0,0 +1,656 @@
+#include "../../include/Fluid/FlipSolver.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void Fluid::FlipSolver::transferToGrid(const std::vector<Particle *> &particles, const AABB &bounds, float cellSize, float particleSpacing, ObstacleField *obstacles, const int numThreads)
+{
+    this->bounds = bounds;
+    this->obstacles = obstacles;
+
+    // cells are stretched so the edges of the grid are the edges of the bounds, otherwise particles pile up against a wall the grid doesn't see
+    glm::vec2 size = bounds.max - bounds.min;
+    int newWidth = std::max(1, static_cast<int>(std::round(size.x / cellSize)));
+    int newHeight = std::max(1, static_cast<int>(std::round(size.y / cellSize)));
+    cellWidth = size.x / newWidth;
+    cellHeight = size.y / newHeight;
+    restParticlesPerCell = cellWidth * cellHeight / (particleSpacing * particleSpacing);
+
+    // the last pressure is only a useful guess on the same grid
+    if (newWidth != width || newHeight != height)
+    {
+        width = newWidth;
+        height = newHeight;
+        pressure.assign(width * height, 0);
+    }
+
+    cellTypes.resize(width * height);
+    particleDensities.resize(width * height);
+    u.resize((width + 1) * height);
+    v.resize(width * (height + 1));
+    uValid.resize(u.size());
+    vValid.resize(v.size());
+
+    sortParticles(particles);
+    iterateRowsThreaded(&FlipSolver::classifyCellsThread, height, numThreads);
+    removeEnclosedFluid();
+    iterateRowsThreaded(&FlipSolver::transferToGridUThread, height, numThreads);
+    iterateRowsThreaded(&FlipSolver::transferToGridVThread, height + 1, numThreads);
+
+    // particles near the surface sample faces no particle reached
+    extrapolate(u, uValid, width + 1, height, 2);
+    extrapolate(v, vValid, width, height + 1, 2);
+    enforceBoundaries();
+
+    uOld = u;
+    vOld = v;
+}
+
+int Fluid::FlipSolver::solvePressure(float dt, float tolerance, int maxIterations, const int numThreads)
+{
+    this->dt = dt;
+
+    int numCells = width * height;
+    divergence.resize(numCells);
+    residual.resize(numCells);
+    preconditioned.resize(numCells);
+    direction.resize(numCells);
+    product.resize(numCells);
+    rowDots.resize(height);
+    rowMaxes.resize(height);
+
+    iterateRowsThreaded(&FlipSolver::startSolveThread, height, numThreads);
+
+    double maxDivergence = maxRows(rowMaxes);
+    if (maxDivergence == 0)
+        return 0;
+
+    // needs the pressure outside the fluid zeroed first
+    iterateRowsThreaded(&FlipSolver::startDirectionThread, height, numThreads);
+
+    double residualDot = sumRows(rowDots);
+    double maxResidual = maxRows(rowMaxes);
+    double threshold = tolerance * maxDivergence;
+    int iteration = 0;
+
+    while (maxResidual > threshold && iteration < maxIterations)
+    {
+        iteration++;
+
+        iterateRowsThreaded(&FlipSolver::multiplyThread, height, numThreads);
+
+        double directionDot = sumRows(rowDots);
+        if (directionDot <= 0)
+            break;
+
+        alpha = residualDot / directionDot;
+        iterateRowsThreaded(&FlipSolver::stepThread, height, numThreads);
+
+        double newResidualDot = sumRows(rowDots);
+        maxResidual = maxRows(rowMaxes);
+
+        beta = newResidualDot / residualDot;
+        residualDot = newResidualDot;
+
+        iterateRowsThreaded(&FlipSolver::updateDirectionThread, height, numThreads);
+    }
+
+    iterateRowsThreaded(&FlipSolver::applyPressureThread, height + 1, numThreads);
+
+    // only faces next to fluid were projected, the rest are refilled from them
+    findFluidFaces();
+    extrapolate(u, uValid, width + 1, height, 2);
+    extrapolate(v, vValid, width, height + 1, 2);
+    enforceBoundaries();
+
+    return iteration;
+}
+
+void Fluid::FlipSolver::transferToParticle(Particle *p, float flipBlend)
+{
+    Vec2 velocity = sampleVelocity(u, v, p->position);
+    Vec2 oldVelocity = sampleVelocity(uOld, vOld, p->position);
+
+    Scalar blend = flipBlend;
+    Vec2 flipVelocity = p->velocity + velocity - oldVelocity;
+    p->velocity = blend * flipVelocity + (1 - blend) * velocity;
+}
+
+int Fluid::FlipSolver::getWidth()
+{
+    return width;
+}
+
+int Fluid::FlipSolver::getHeight()
+{
+    return height;
+}
+
+Fluid::FlipCellType Fluid::FlipSolver::getCellType(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= width || y >= height)
+        return FLIP_SOLID;
+
+    return cellTypes[y * width + x];
+}
+
+void Fluid::FlipSolver::iterateRowsThreaded(void (FlipSolver::*func)(int, int), int numRows, const int numThreads)
+{
+    std::thread threads[numThreads];
+    int perThread = std::ceil(static_cast<float>(numRows) / numThreads);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        int start = i * perThread;
+        int end = std::min(start + perThread - 1, numRows - 1);
+
+        threads[i] = std::thread(func, this, start, end);
+    }
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads[i].join();
+    }
+}
+
+void Fluid::FlipSolver::sortParticles(const std::vector<Particle *> &particles)
+{
+    auto getCell = [&](Particle *p)
+    {
+        Vec2 local = (p->position - Vec2(bounds.min)) / Vec2(cellWidth, cellHeight);
+        int x = std::clamp(static_cast<int>(std::floor(local.x)), 0, width - 1);
+        int y = std::clamp(static_cast<int>(std::floor(local.y)), 0, height - 1);
+        return y * width + x;
+    };
+
+    // count particles in each cell, then turn counts into offsets
+    cellOffsets.assign(width * height + 1, 0);
+
+    for (auto p : particles)
+    {
+        cellOffsets[getCell(p) + 1]++;
+    }
+
+    for (int i = 0; i < width * height; i++)
+    {
+        cellOffsets[i + 1] += cellOffsets[i];
+    }
+
+    // filling moves every offset forward to the start of the next cell, so shift them back after
+    cellParticles.resize(particles.size());
+
+    for (auto p : particles)
+    {
+        cellParticles[cellOffsets[getCell(p)]++] = p;
+    }
+
+    for (int i = width * height; i > 0; i--)
+    {
+        cellOffsets[i] = cellOffsets[i - 1];
+    }
+
+    cellOffsets[0] = 0;
+}
+
+void Fluid::FlipSolver::transferToGridUThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        for (int x = 0; x <= width; x++)
+        {
+            // u faces are on the left of cells
+            Vec2 face = Vec2(bounds.min) + Vec2(x, y + 0.5f) * Vec2(cellWidth, cellHeight);
+            Scalar velocity = 0;
+            Scalar weight = 0;
+
+            for (int cy = std::max(y - 1, 0); cy <= std::min(y + 1, height - 1); cy++)
+            {
+                for (int cx = std::max(x - 1, 0); cx <= std::min(x, width - 1); cx++)
+                {
+                    int cell = cy * width + cx;
+
+                    for (int i = cellOffsets[cell]; i < cellOffsets[cell + 1]; i++)
+                    {
+                        Particle *p = cellParticles[i];
+                        Scalar w = getWeight(p->position - face);
+
+                        velocity += w * p->velocity.x;
+                        weight += w;
+                    }
+                }
+            }
+
+            int index = y * (width + 1) + x;
+            u[index] = weight > 0 ? velocity / weight : 0;
+            uValid[index] = weight > 0;
+        }
+    }
+}
+
+void Fluid::FlipSolver::transferToGridVThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            // v faces are on the top of cells
+            Vec2 face = Vec2(bounds.min) + Vec2(x + 0.5f, y) * Vec2(cellWidth, cellHeight);
+            Scalar velocity = 0;
+            Scalar weight = 0;
+
+            for (int cy = std::max(y - 1, 0); cy <= std::min(y, height - 1); cy++)
+            {
+                for (int cx = std::max(x - 1, 0); cx <= std::min(x + 1, width - 1); cx++)
+                {
+                    int cell = cy * width + cx;
+
+                    for (int i = cellOffsets[cell]; i < cellOffsets[cell + 1]; i++)
+                    {
+                        Particle *p = cellParticles[i];
+                        Scalar w = getWeight(p->position - face);
+
+                        velocity += w * p->velocity.y;
+                        weight += w;
+                    }
+                }
+            }
+
+            int index = y * width + x;
+            v[index] = weight > 0 ? velocity / weight : 0;
+            vValid[index] = weight > 0;
+        }
+    }
+}
+
+void Fluid::FlipSolver::classifyCellsThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int cell = y * width + x;
+            cellTypes[cell] = cellOffsets[cell + 1] > cellOffsets[cell] ? FLIP_FLUID : FLIP_AIR;
+
+            // particles per cell, smoothed over the neighbouring cells
+            Vec2 centre = Vec2(bounds.min) + Vec2(x + 0.5f, y + 0.5f) * Vec2(cellWidth, cellHeight);
+            Scalar density = 0;
+
+            for (int cy = std::max(y - 1, 0); cy <= std::min(y + 1, height - 1); cy++)
+            {
+                for (int cx = std::max(x - 1, 0); cx <= std::min(x + 1, width - 1); cx++)
+                {
+                    int neighbour = cy * width + cx;
+
+                    for (int i = cellOffsets[neighbour]; i < cellOffsets[neighbour + 1]; i++)
+                    {
+                        density += getWeight(cellParticles[i]->position - centre);
+                    }
+                }
+            }
+
+            particleDensities[cell] = density;
+
+            if (obstacles != nullptr && obstacles->sample(centre).distance < 0)
+                cellTypes[cell] = FLIP_SOLID;
+        }
+    }
+}
+
+void Fluid::FlipSolver::removeEnclosedFluid()
+{
+    // a fluid cell with only solid neighbours has a zero diagonal and can't be preconditioned,
+    // nothing can flow in or out of it anyway so it is solved as air
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (isFluid(x, y) && getDiagonal(x, y) == 0)
+                cellTypes[y * width + x] = FLIP_AIR;
+        }
+    }
+}
+
+void Fluid::FlipSolver::enforceBoundaries()
+{
+    // nothing flows through a face touching a solid cell, the edges of the grid are solid
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x <= width; x++)
+        {
+            if (isSolid(x - 1, y) || isSolid(x, y))
+                u[y * (width + 1) + x] = 0;
+        }
+    }
+
+    for (int y = 0; y <= height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (isSolid(x, y - 1) || isSolid(x, y))
+                v[y * width + x] = 0;
+        }
+    }
+}
+
+void Fluid::FlipSolver::extrapolate(std::vector<Scalar> &field, std::vector<char> &valid, int fieldWidth, int fieldHeight, int numLayers)
+{
+    // faces filled in this layer are marked 2 so they aren't used until the next layer
+    for (int layer = 0; layer < numLayers; layer++)
+    {
+        for (int y = 0; y < fieldHeight; y++)
+        {
+            for (int x = 0; x < fieldWidth; x++)
+            {
+                int index = y * fieldWidth + x;
+                if (valid[index])
+                    continue;
+
+                Scalar sum = 0;
+                int count = 0;
+
+                const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+                for (auto &offset : offsets)
+                {
+                    int nx = x + offset[0];
+                    int ny = y + offset[1];
+
+                    if (nx < 0 || ny < 0 || nx >= fieldWidth || ny >= fieldHeight || valid[ny * fieldWidth + nx] != 1)
+                        continue;
+
+                    sum += field[ny * fieldWidth + nx];
+                    count++;
+                }
+
+                if (count > 0)
+                {
+                    field[index] = sum / count;
+                    valid[index] = 2;
+                }
+            }
+        }
+
+        for (auto &isValid : valid)
+        {
+            if (isValid == 2)
+                isValid = 1;
+        }
+    }
+}
+
+void Fluid::FlipSolver::findFluidFaces()
+{
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x <= width; x++)
+        {
+            uValid[y * (width + 1) + x] = isFluid(x - 1, y) || isFluid(x, y);
+        }
+    }
+
+    for (int y = 0; y <= height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            vValid[y * width + x] = isFluid(x, y - 1) || isFluid(x, y);
+        }
+    }
+}
+
+void Fluid::FlipSolver::startSolveThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        double maxDivergence = 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            int cell = y * width + x;
+
+            // air is at zero pressure and solids aren't solved for
+            if (!isFluid(x, y))
+            {
+                pressure[cell] = 0;
+                divergence[cell] = 0;
+                residual[cell] = 0;
+                continue;
+            }
+
+            Scalar flowX = (u[y * (width + 1) + x + 1] - u[y * (width + 1) + x]) / cellWidth;
+            Scalar flowY = (v[(y + 1) * width + x] - v[y * width + x]) / cellHeight;
+
+            // particles drift together over time, so compressed cells are made to push out what they hold too many of
+            Scalar compression = std::max(particleDensities[cell] / restParticlesPerCell - 1, static_cast<Scalar>(0));
+            divergence[cell] = DRIFT_CORRECTION * compression / dt - flowX - flowY;
+
+            maxDivergence = std::max(maxDivergence, static_cast<double>(std::abs(divergence[cell])));
+        }
+
+        rowMaxes[y] = maxDivergence;
+    }
+}
+
+void Fluid::FlipSolver::multiplyThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        double dot = 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            int cell = y * width + x;
+
+            if (!isFluid(x, y))
+            {
+                product[cell] = 0;
+                continue;
+            }
+
+            product[cell] = applyLaplacian(direction, x, y);
+            dot += direction[cell] * product[cell];
+        }
+
+        rowDots[y] = dot;
+    }
+}
+
+void Fluid::FlipSolver::stepThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        double dot = 0;
+        double maxResidual = 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            int cell = y * width + x;
+
+            if (!isFluid(x, y))
+                continue;
+
+            pressure[cell] += alpha * direction[cell];
+            residual[cell] -= alpha * product[cell];
+
+            // jacobi preconditioner
+            preconditioned[cell] = residual[cell] / getDiagonal(x, y);
+
+            dot += residual[cell] * preconditioned[cell];
+            maxResidual = std::max(maxResidual, static_cast<double>(std::abs(residual[cell])));
+        }
+
+        rowDots[y] = dot;
+        rowMaxes[y] = maxResidual;
+    }
+}
+
+void Fluid::FlipSolver::startDirectionThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        double dot = 0;
+        double maxResidual = 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            int cell = y * width + x;
+
+            if (!isFluid(x, y))
+            {
+                preconditioned[cell] = 0;
+                direction[cell] = 0;
+                continue;
+            }
+
+            // the residual of the last pressure
+            residual[cell] = divergence[cell] - applyLaplacian(pressure, x, y);
+            preconditioned[cell] = residual[cell] / getDiagonal(x, y);
+            direction[cell] = preconditioned[cell];
+
+            dot += residual[cell] * preconditioned[cell];
+            maxResidual = std::max(maxResidual, static_cast<double>(std::abs(residual[cell])));
+        }
+
+        rowDots[y] = dot;
+        rowMaxes[y] = maxResidual;
+    }
+}
+
+void Fluid::FlipSolver::updateDirectionThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int cell = y * width + x;
+
+            if (isFluid(x, y))
+                direction[cell] = preconditioned[cell] + beta * direction[cell];
+        }
+    }
+}
+
+void Fluid::FlipSolver::applyPressureThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        // u faces between horizontal neighbours, pressure outside the fluid is zero
+        for (int x = 1; y < height && x < width; x++)
+        {
+            if (isSolid(x - 1, y) || isSolid(x, y) || !(isFluid(x - 1, y) || isFluid(x, y)))
+                continue;
+
+            u[y * (width + 1) + x] -= (pressure[y * width + x] - pressure[y * width + x - 1]) / cellWidth;
+        }
+
+        // v faces between vertical neighbours
+        for (int x = 0; y > 0 && y < height && x < width; x++)
+        {
+            if (isSolid(x, y - 1) || isSolid(x, y) || !(isFluid(x, y - 1) || isFluid(x, y)))
+                continue;
+
+            v[y * width + x] -= (pressure[y * width + x] - pressure[(y - 1) * width + x]) / cellHeight;
+        }
+    }
+}
+
+Fluid::Scalar Fluid::FlipSolver::applyLaplacian(const std::vector<Scalar> &values, int x, int y)
+{
+    Scalar inverseWidthSqr = 1 / (cellWidth * cellWidth);
+    Scalar inverseHeightSqr = 1 / (cellHeight * cellHeight);
+    Scalar result = getDiagonal(x, y) * values[y * width + x];
+
+    if (isFluid(x - 1, y))
+        result -= values[y * width + x - 1] * inverseWidthSqr;
+
+    if (isFluid(x + 1, y))
+        result -= values[y * width + x + 1] * inverseWidthSqr;
+
+    if (isFluid(x, y - 1))
+        result -= values[(y - 1) * width + x] * inverseHeightSqr;
+
+    if (isFluid(x, y + 1))
+        result -= values[(y + 1) * width + x] * inverseHeightSqr;
+
+    return result;
+}
+
+Fluid::Scalar Fluid::FlipSolver::getDiagonal(int x, int y)
+{
+    // every neighbour that isn't solid, air neighbours are at zero pressure so don't appear off the diagonal
+    int openX = !isSolid(x - 1, y) + !isSolid(x + 1, y);
+    int openY = !isSolid(x, y - 1) + !isSolid(x, y + 1);
+
+    return openX / (cellWidth * cellWidth) + openY / (cellHeight * cellHeight);
+}
+
+Fluid::Scalar Fluid::FlipSolver::getWeight(const Vec2 &offset)
+{
+    Scalar wx = 1 - std::abs(offset.x) / cellWidth;
+    Scalar wy = 1 - std::abs(offset.y) / cellHeight;
+
+    return std::max(wx, static_cast<Scalar>(0)) * std::max(wy, static_cast<Scalar>(0));
+}
+
+Fluid::Vec2 Fluid::FlipSolver::sampleVelocity(const std::vector<Scalar> &uField, const std::vector<Scalar> &vField, const Vec2 &position)
+{
+    Vec2 local = (position - Vec2(bounds.min)) / Vec2(cellWidth, cellHeight);
+
+    return Vec2(
+        sampleField(uField, width + 1, height, local.x, local.y - 0.5f),
+        sampleField(vField, width, height + 1, local.x - 0.5f, local.y));
+}
+
+Fluid::Scalar Fluid::FlipSolver::sampleField(const std::vector<Scalar> &field, int fieldWidth, int fieldHeight, Scalar x, Scalar y)
+{
+    // bilinear, clamped to the edges of the field
+    x = std::clamp(x, static_cast<Scalar>(0), static_cast<Scalar>(fieldWidth - 1));
+    y = std::clamp(y, static_cast<Scalar>(0), static_cast<Scalar>(fieldHeight - 1));
+
+    int x0 = std::min(static_cast<int>(x), std::max(fieldWidth - 2, 0));
+    int y0 = std::min(static_cast<int>(y), std::max(fieldHeight - 2, 0));
+    int x1 = std::min(x0 + 1, fieldWidth - 1);
+    int y1 = std::min(y0 + 1, fieldHeight - 1);
+
+    Scalar tx = x - x0;
+    Scalar ty = y - y0;
+
+    Scalar top = field[y0 * fieldWidth + x0] * (1 - tx) + field[y0 * fieldWidth + x1] * tx;
+    Scalar bottom = field[y1 * fieldWidth + x0] * (1 - tx) + field[y1 * fieldWidth + x1] * tx;
+
+    return top * (1 - ty) + bottom * ty;
+}
+
+bool Fluid::FlipSolver::isSolid(int x, int y)
+{
+    return getCellType(x, y) == FLIP_SOLID;
+}
+
+bool Fluid::FlipSolver::isFluid(int x, int y)
+{
+    return getCellType(x, y) == FLIP_FLUID;
+}
+
+double Fluid::FlipSolver::sumRows(const std::vector<double> &rows)
+{
+    double sum = 0;
+
+    for (double row : rows)
+    {
+        sum += row;
+    }
+
+    return sum;
+}
+
+double Fluid::FlipSolver::maxRows(const std::vector<double> &rows)
+{
+    double max = 0;
+
+    for (double row : rows)
+    {
+        max = std::max(max, row);
+    }
+
+    return max;
+}
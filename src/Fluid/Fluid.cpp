@@ -1,4 +1,7 @@
 #include "../../include/Fluid/Fluid.h"
+#include "../../include/Fluid/Checkpoint.h"
+#include "../../include/Utility/MappedFile.h"
+#include "../../include/Utility/Random.h"
 
 #include <glm/glm.hpp>
 #include <math.h>
@@ -6,6 +9,7 @@
 #include <numbers>
 #include <chrono>
 #include <thread>
+#include <algorithm>
 
 Fluid::Fluid::Fluid(FluidOptions &options) : options(options)
 {
@@ -17,6 +21,8 @@ Fluid::Fluid::~Fluid()
     {
         delete p;
     }
+
+    delete watchdog;
 }
 
 void Fluid::Fluid::init()
@@ -32,6 +38,7 @@ void Fluid::Fluid::init()
     {
         Particle *p = new Particle();
 
+        p->id = i;
         p->position = glm::vec2(i % gridSize, i / gridSize);
         p->position *= particleOffset;
         p->position += options.initialCentre;
@@ -43,21 +50,43 @@ void Fluid::Fluid::init()
 
         p->density = 0;
         p->pressure = 0;
-        p->pressureForce = glm::vec2(0, 0);
-        p->viscosityForce = glm::vec2(0, 0);
-        p->tensionForce = glm::vec2(0, 0);
+        p->pressureForce = Vec2(0, 0);
+        p->viscosityForce = Vec2(0, 0);
+        p->tensionForce = Vec2(0, 0);
 
         p->neighbours = std::vector<ParticleNeighbour>();
 
         particles.push_back(p);
     }
+
+    gridValid = false;
+    step = 0;
+    diagnosticsLog.clear();
+
+    // old snapshots are of a different fluid
+    if (watchdog != nullptr)
+        enableWatchdog(watchdog->getOptions());
 }
 
 void Fluid::Fluid::update(float dt)
 {
+    if (watchdog != nullptr)
+        dt *= watchdog->getDtScale();
+
     // store dt for threads
     this->dt = dt;
 
+    diagnosticsPartials.assign((particles.size() + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE, DiagnosticsPartial{});
+
+    // times each phase into stats
+    auto phaseStart = std::chrono::steady_clock::now();
+    auto endPhase = [&](FluidPhase phase)
+    {
+        auto now = std::chrono::steady_clock::now();
+        stats.phaseSeconds[phase] = std::chrono::duration<float>(now - phaseStart).count();
+        phaseStart = now;
+    };
+
     // pre solve
     for (auto p : particles)
     {
@@ -65,45 +94,97 @@ void Fluid::Fluid::update(float dt)
 
         // calculate predicted position
         if (options.usePredictedPositions)
-            p->predictedPosition = p->position + p->velocity * dt;
+            p->predictedPosition = p->position + p->velocity * this->dt;
     }
 
-    // update grid
-    // int start = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    endPhase(PHASE_PRE_SOLVE);
 
-    updateGrid(options.usePredictedPositions);
+    if (options.solver == FLIP_SOLVER)
+    {
+        // flip needs no neighbours, every force but gravity and attractors comes from the grid
+        binAttractors();
 
-    // int end = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    // std::cout << std::endl
-    //           << "update grid: " << end - start << "ms" << std::endl;
+        for (auto p : particles)
+        {
+            p->mass = options.particleMass;
+            p->radius = options.particleRadius;
+            applyAttractors(p, dt);
+        }
 
-    for (auto p : particles)
-    {
-        // update mass and radius
-        p->mass = options.particleMass;
-        p->radius = options.particleRadius;
+        flipSolver.transferToGrid(particles, options.boundingBox, options.flipCellSize, options.particleRadius * 2 + options.particleSpacing, obstacles, options.numThreads);
+
+        // the neighbour grid is stale once particles move without it
+        gridValid = false;
+        stats.gridMoves = 0;
+        stats.gridChurn = 0;
+        stats.gridRebuilt = false;
+
+        endPhase(PHASE_GRID);
+        endPhase(PHASE_NEIGHBOURS);
+        endPhase(PHASE_DENSITY_PRESSURE);
+        endPhase(PHASE_FORCES);
+
+        stats.viscosityIterations = 0;
+        endPhase(PHASE_VISCOSITY_SOLVE);
     }
+    else
+    {
+        // update grid
+        updateGrid(options.usePredictedPositions);
+
+        for (auto p : particles)
+        {
+            // update mass and radius
+            p->mass = options.particleMass;
+            p->radius = options.particleRadius;
+        }
+
+        endPhase(PHASE_GRID);
 
-    // start = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        if (isGridSparse())
+            iterateParticlesThreaded(&Fluid::findNeighboursParticlesThread, options.numThreads);
+        else
+            iterateGridCellsThreaded(&Fluid::findNeighboursThread, options.numThreads);
 
-    iterateGridCellsThreaded(&Fluid::findNeighboursThread, options.numThreads);
+        endPhase(PHASE_NEIGHBOURS);
 
-    // end = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    // std::cout << "get neighbours: " << end - start << "ms" << std::endl;
+        // solve
+        iterateParticlesThreaded(&Fluid::solveDensityPressureThread, options.numThreads);
+        endPhase(PHASE_DENSITY_PRESSURE);
 
-    // solve
-    // start = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        // solve forces
+        iterateParticlesThreaded(&Fluid::solveForcesThread, options.numThreads);
+        binAttractors();
+        endPhase(PHASE_FORCES);
 
-    iterateParticlesThreaded(&Fluid::solveDensityPressureThread, options.numThreads);
+        stats.viscosityIterations = 0;
+        if (options.implicitViscosity)
+            solveImplicitViscosity();
 
-    // solve forces
-    iterateParticlesThreaded(&Fluid::solveForcesThread, options.numThreads);
+        endPhase(PHASE_VISCOSITY_SOLVE);
+    }
+
+    stats.solverIterations = 0;
+    if (options.solver == PCISPH_SOLVER)
+        solvePcisph();
+    else if (options.solver == PBF_SOLVER)
+        solvePbf();
+    else if (options.solver == FLIP_SOLVER)
+        stats.solverIterations = flipSolver.solvePressure(dt, options.solverTolerance, options.solverMaxIterations, options.numThreads);
 
-    // end = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    // std::cout << "solve: " << end - start << "ms" << std::endl;
+    endPhase(PHASE_PRESSURE_SOLVE);
 
     // apply forces
     iterateParticlesThreaded(&Fluid::applyForcesThread, options.numThreads);
+    endPhase(PHASE_APPLY_FORCES);
+
+    reduceDiagnostics();
+
+    if (watchdog != nullptr && !watchdog->hasFailed())
+        watch();
+
+    if (publisher.isOpen())
+        publisher.publish(particles, dt);
 }
 
 std::vector<Fluid::Particle *> &Fluid::Fluid::getParticles()
@@ -119,31 +200,232 @@ void Fluid::Fluid::clearParticles()
     }
 
     particles.clear();
+    gridValid = false;
 }
 
-void Fluid::Fluid::addAttractor(FluidAttractor *attractor)
+Fluid::FluidAttractorHandle Fluid::Fluid::addAttractor(const FluidAttractor &attractor)
 {
-    removeAttractor(attractor);
+    int slot;
+
+    if (freeAttractorSlots.size() > 0)
+    {
+        slot = freeAttractorSlots.back();
+        freeAttractorSlots.pop_back();
+    }
+    else
+    {
+        slot = attractorSlots.size();
+        attractorSlots.push_back(-1);
+        attractorSlotGenerations.push_back(0);
+    }
+
+    attractorSlots[slot] = attractors.size();
+    attractorSlotOfIndex.push_back(slot);
     attractors.push_back(attractor);
+
+    return FluidAttractorHandle{slot, attractorSlotGenerations[slot]};
 }
 
-bool Fluid::Fluid::removeAttractor(FluidAttractor *attractor)
+bool Fluid::Fluid::removeAttractor(FluidAttractorHandle handle)
 {
-    for (int i = 0; i < attractors.size(); i++)
-    {
-        if (attractors[i] == attractor)
-        {
-            attractors.erase(attractors.begin() + i);
-            return true;
-        }
-    }
+    if (getAttractor(handle) == nullptr)
+        return false;
+
+    // swap remove, the last attractor takes the removed attractor's index
+    int index = attractorSlots[handle.slot];
+    int lastSlot = attractorSlotOfIndex.back();
+
+    attractors[index] = attractors.back();
+    attractorSlotOfIndex[index] = lastSlot;
+    attractorSlots[lastSlot] = index;
+
+    attractors.pop_back();
+    attractorSlotOfIndex.pop_back();
 
-    return false;
+    attractorSlots[handle.slot] = -1;
+    attractorSlotGenerations[handle.slot]++;
+    freeAttractorSlots.push_back(handle.slot);
+
+    return true;
 }
 
 void Fluid::Fluid::clearAttractors()
 {
+    for (int slot = 0; slot < attractorSlots.size(); slot++)
+    {
+        if (attractorSlots[slot] == -1)
+            continue;
+
+        attractorSlots[slot] = -1;
+        attractorSlotGenerations[slot]++;
+        freeAttractorSlots.push_back(slot);
+    }
+
     attractors.clear();
+    attractorSlotOfIndex.clear();
+}
+
+Fluid::FluidAttractor *Fluid::Fluid::getAttractor(FluidAttractorHandle handle)
+{
+    if (handle.slot < 0 || handle.slot >= attractorSlots.size())
+        return nullptr;
+
+    if (attractorSlots[handle.slot] == -1 || attractorSlotGenerations[handle.slot] != handle.generation)
+        return nullptr;
+
+    return &attractors[attractorSlots[handle.slot]];
+}
+
+int Fluid::Fluid::getNumAttractors()
+{
+    return attractors.size();
+}
+
+void Fluid::Fluid::setObstacles(ObstacleField *obstacles)
+{
+    this->obstacles = obstacles;
+}
+
+Fluid::FluidOptions &Fluid::Fluid::getOptions()
+{
+    return options;
+}
+
+bool Fluid::Fluid::saveCheckpoint(const std::string &path)
+{
+    if (checkpointWriter.isWriting())
+        return false;
+
+    Checkpoint::write(checkpointWriter.getBuffer(), options, particles, attractors);
+    return checkpointWriter.start(path);
+}
+
+bool Fluid::Fluid::isSavingCheckpoint()
+{
+    return checkpointWriter.isWriting();
+}
+
+bool Fluid::Fluid::loadCheckpoint(const std::string &path)
+{
+    Utility::MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    auto header = Checkpoint::validate(file.getData(), file.getSize());
+    if (header == nullptr)
+        return false;
+
+    options = *Checkpoint::getOptions(file.getData());
+
+    restoreParticles(file.getData(), header->numParticles);
+
+    clearAttractors();
+
+    auto loadedAttractors = Checkpoint::getAttractors(file.getData());
+    for (int i = 0; i < header->numAttractors; i++)
+    {
+        addAttractor(loadedAttractors[i]);
+    }
+
+    gridValid = false;
+
+    if (watchdog != nullptr)
+        enableWatchdog(watchdog->getOptions());
+
+    return true;
+}
+
+void Fluid::Fluid::restoreParticles(const char *data, uint64_t numParticles)
+{
+    // reuse existing particles where possible
+    while (particles.size() > numParticles)
+    {
+        delete particles.back();
+        particles.pop_back();
+    }
+
+    while (particles.size() < numParticles)
+    {
+        particles.push_back(new Particle());
+    }
+
+    auto records = Checkpoint::getParticles(data);
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        auto p = particles[i];
+        auto &record = records[i];
+
+        p->id = i;
+        p->position = record.position;
+        p->velocity = record.velocity;
+        p->predictedPosition = record.predictedPosition;
+        p->radius = record.radius;
+        p->mass = record.mass;
+        p->density = record.density;
+        p->pressure = record.pressure;
+        p->neighbours.clear();
+    }
+
+    gridValid = false;
+}
+
+void Fluid::Fluid::enableWatchdog(const WatchdogOptions &watchdogOptions)
+{
+    // the options may belong to the current watchdog
+    auto newWatchdog = new Watchdog(watchdogOptions);
+    delete watchdog;
+    watchdog = newWatchdog;
+
+    // always have somewhere to roll back to
+    watchdog->snapshot(step, options, particles, attractors);
+}
+
+void Fluid::Fluid::disableWatchdog()
+{
+    delete watchdog;
+    watchdog = nullptr;
+}
+
+Fluid::Watchdog *Fluid::Fluid::getWatchdog()
+{
+    return watchdog;
+}
+
+void Fluid::Fluid::watch()
+{
+    if (watchdog->check(diagnostics, particles.size() * options.particleMass))
+    {
+        if (watchdog->shouldSnapshot(step))
+            watchdog->snapshot(step, options, particles, attractors);
+
+        return;
+    }
+
+    int snapshotStep;
+    auto data = watchdog->rollback(snapshotStep);
+    if (data == nullptr)
+        return;
+
+    // only the particles are rolled back, options and attractors are left as they are
+    auto header = Checkpoint::validate(data->data(), data->size());
+    restoreParticles(data->data(), header->numParticles);
+    step = snapshotStep;
+}
+
+bool Fluid::Fluid::startPublishing(const std::string &name, int maxParticles)
+{
+    return publisher.open(name, maxParticles < 0 ? options.numParticles : maxParticles);
+}
+
+void Fluid::Fluid::stopPublishing()
+{
+    publisher.close();
+}
+
+bool Fluid::Fluid::isPublishing()
+{
+    return publisher.isOpen();
 }
 
 Fluid::Grid &Fluid::Fluid::getGrid()
@@ -151,198 +433,895 @@ Fluid::Grid &Fluid::Fluid::getGrid()
     return grid;
 }
 
-void Fluid::Fluid::solveDensityPressure(Particle *p)
+Fluid::SpatialHash &Fluid::Fluid::getSpatialHash()
+{
+    return spatialHash;
+}
+
+void Fluid::Fluid::forEachGridCell(const std::function<void(const std::pair<int, int> &, const std::vector<Particle *> &)> &func)
+{
+    if (isGridSparse())
+    {
+        for (int i = 0; i < spatialHash.getNumCells(); i++)
+        {
+            func(spatialHash.getCellKey(i), spatialHash.getCellAt(i));
+        }
+
+        return;
+    }
+
+    for (auto &kv : grid)
+    {
+        func(kv.first, kv.second);
+    }
+}
+
+bool Fluid::Fluid::isGridSparse()
+{
+    return options.gridType == GridType::SPARSE_GRID || !options.useBoundingBox;
+}
+
+const Fluid::FluidStats &Fluid::Fluid::getStats()
+{
+    return stats;
+}
+
+const Fluid::FluidDiagnostics &Fluid::Fluid::getDiagnostics()
+{
+    return diagnostics;
+}
+
+Fluid::DiagnosticsLog &Fluid::Fluid::getDiagnosticsLog()
+{
+    return diagnosticsLog;
+}
+
+void Fluid::Fluid::reduceDiagnostics()
+{
+    DiagnosticsPartial total{};
+
+    for (auto &partial : diagnosticsPartials)
+    {
+        total.densityError += partial.densityError;
+        total.maxDensityError = std::max(total.maxDensityError, partial.maxDensityError);
+        total.pressureClampHits += partial.pressureClampHits;
+        total.kineticEnergy += partial.kineticEnergy;
+        total.potentialEnergy += partial.potentialEnergy;
+        total.maxSpeedSqr = std::max(total.maxSpeedSqr, partial.maxSpeedSqr);
+    }
+
+    float restDensity = options.desiredRestDensity == 0 ? 1.0f : options.desiredRestDensity;
+    int numParticles = std::max(static_cast<int>(particles.size()), 1);
+
+    diagnostics.step = step++;
+    diagnostics.dt = dt;
+    diagnostics.kineticEnergy = total.kineticEnergy;
+    diagnostics.potentialEnergy = total.potentialEnergy;
+    diagnostics.maxSpeed = std::sqrt(total.maxSpeedSqr);
+    diagnostics.meanDensityError = total.densityError / numParticles / restDensity;
+    diagnostics.maxDensityError = total.maxDensityError / restDensity;
+    diagnostics.pressureClampHits = total.pressureClampHits;
+
+    diagnosticsLog.push(diagnostics);
+}
+
+void Fluid::Fluid::solveDensityPressure(Particle *p)
+{
+    p->density = 0;
+
+    for (auto q : p->neighbours)
+    {
+        p->density += q.particle->mass * smoothingKernelPoly6.calculate(&q.distance, options.smoothingRadius);
+    }
+
+    // solved iteratively once every other force has been applied
+    if (options.solver != SPH_SOLVER)
+        return;
+
+    p->pressure = options.stiffness * (p->density - options.desiredRestDensity);
+
+    // limit pressure to 200
+    // to try and prevent blow ups
+    if (p->pressure > options.pressureLimit)
+        p->pressure = options.pressureLimit;
+}
+
+uint64_t Fluid::Fluid::getStateHash()
+{
+    // fnv-1a
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    auto add = [&](const void *data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+        }
+    };
+
+    for (auto p : particles)
+    {
+        add(&p->position, sizeof(p->position));
+        add(&p->velocity, sizeof(p->velocity));
+        add(&p->density, sizeof(p->density));
+        add(&p->pressure, sizeof(p->pressure));
+    }
+
+    return hash;
+}
+
+float Fluid::Fluid::solveDensityAtPoint(const glm::vec2 &point)
+{
+    Scalar density = 0;
+
+    for (auto p : particles)
+    {
+        ParticleDistance pd;
+        pd.direction = getSeparation(point, p->position);
+        pd.distance = glm::length(pd.direction);
+        pd.direction /= pd.distance;
+
+        density += p->mass * smoothingKernelPoly6.calculate(&pd, options.smoothingRadius);
+    }
+
+    return density;
+}
+
+void Fluid::Fluid::solvePressureForce(Particle *p)
+{
+    // forces are summed in Scalar and stored once, since they may be stored in a smaller type
+    Vec2 pressureForce(0, 0);
+    Vec2 pressureNearForce = p->pressureNearForce;
+
+    for (auto q : p->neighbours)
+    {
+        Scalar sharedPressure = (p->pressure + q.particle->pressure) / 2;
+        Scalar smoothing = smoothingKernelSpiky.calculateGradient(&q.distance, options.smoothingRadius);
+
+        Vec2 force = sharedPressure * q.distance.direction * q.particle->mass / q.particle->density;
+
+        pressureForce += force * smoothing;
+        pressureNearForce += force * static_cast<Scalar>(std::pow(smoothing, 4));
+    }
+
+    p->pressureForce = -pressureForce;
+    p->pressureNearForce = -pressureNearForce;
+}
+
+void Fluid::Fluid::solveViscosityForce(Particle *p)
+{
+    Vec2 viscosityForce(0, 0);
+
+    for (auto q : p->neighbours)
+    {
+        viscosityForce += (q.particle->velocity - p->velocity) * smoothingKernelPoly6.calculate(&q.distance, options.smoothingRadius);
+    }
+
+    p->viscosityForce = viscosityForce * static_cast<Scalar>(options.viscosity);
+}
+
+void Fluid::Fluid::solveTensionForce(Particle *p)
+{
+    Vec2 tensionForce(0, 0);
+
+    for (auto q : p->neighbours)
+    {
+        Scalar colorFieldNoSmoothingKernel = q.particle->mass * (1 / q.particle->density);
+
+        Vec2 n = colorFieldNoSmoothingKernel * smoothingKernelPoly6.calculateGradient(&q.distance, options.smoothingRadius) * q.distance.direction;
+        Scalar modN = glm::length(n);
+
+        if (modN < options.surfaceTensionThreshold)
+            continue;
+
+        Vec2 normalizedN = n / modN;
+        Scalar colorFieldLaplacian = colorFieldNoSmoothingKernel * smoothingKernelPoly6.calculateLaplacian(&q.distance, options.smoothingRadius);
+
+        tensionForce += -options.surfaceTension * colorFieldLaplacian * normalizedN;
+    }
+
+    p->tensionForce = tensionForce;
+}
+
+void Fluid::Fluid::applyGravity(Particle *p, Scalar dt)
+{
+    p->velocity += Vec2(options.gravity) * dt;
+}
+
+void Fluid::Fluid::applySPHForces(Particle *p, Scalar dt)
+{
+    if (p->density == 0)
+    {
+        return;
+    }
+
+    Vec2 forces = Vec2(p->pressureForce) + Vec2(p->pressureNearForce) + Vec2(p->viscosityForce) + Vec2(p->tensionForce);
+    p->velocity += (forces / p->density) * dt;
+}
+
+void Fluid::Fluid::applyAttractors(Particle *p, Scalar dt)
+{
+    if (attractorBinsX == 0 || attractorBinsY == 0)
+        return;
+
+    Vec2 bin = glm::floor((p->position - Vec2(attractorBinOrigin)) / static_cast<Scalar>(attractorBinSize));
+    if (bin.x < 0 || bin.y < 0 || bin.x >= attractorBinsX || bin.y >= attractorBinsY)
+        return;
+
+    // only attractors which overlap the particle's bin can reach it
+    int binIndex = static_cast<int>(bin.y) * attractorBinsX + static_cast<int>(bin.x);
+
+    for (int i = attractorBinOffsets[binIndex]; i < attractorBinOffsets[binIndex + 1]; i++)
+    {
+        const FluidAttractor &a = attractors[attractorBinEntries[i]];
+
+        Vec2 pToA = Vec2(a.position) - p->position;
+        Scalar distSqr = glm::dot(pToA, pToA);
+
+        if (distSqr >= a.radius * a.radius || distSqr == 0)
+            continue;
+
+        Scalar dist = std::sqrt(distSqr);
+        ParticleDistance pd{
+            dist,
+            pToA / dist,
+        };
+
+        p->velocity += -a.strength * smoothingKernelPoly6.calculateGradient(&pd, a.radius) * pd.direction * dt;
+    }
+}
+
+void Fluid::Fluid::binAttractors()
+{
+    attractorBinsX = 0;
+    attractorBinsY = 0;
+
+    if (attractors.size() == 0)
+        return;
+
+    // bins cover all attractors
+    glm::vec2 min = attractors[0].position;
+    glm::vec2 max = attractors[0].position;
+    float totalRadius = 0;
+
+    for (auto &a : attractors)
+    {
+        min = glm::min(min, a.position - glm::vec2(a.radius, a.radius));
+        max = glm::max(max, a.position + glm::vec2(a.radius, a.radius));
+        totalRadius += a.radius;
+    }
+
+    // bins are about the size of an attractor, but there are never more than 128 bins on an axis
+    glm::vec2 extent = max - min;
+    attractorBinSize = std::max(2.0f * totalRadius / attractors.size(), std::max(extent.x, extent.y) / 128.0f);
+    attractorBinSize = std::max(attractorBinSize, 1.0f);
+    attractorBinOrigin = min;
+    attractorBinsX = static_cast<int>(extent.x / attractorBinSize) + 1;
+    attractorBinsY = static_cast<int>(extent.y / attractorBinSize) + 1;
+
+    // count attractors in each bin, then turn counts into offsets
+    attractorBinOffsets.assign(attractorBinsX * attractorBinsY + 1, 0);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < attractors.size(); i++)
+        {
+            auto &a = attractors[i];
+            glm::vec2 start = glm::floor((a.position - glm::vec2(a.radius, a.radius) - min) / attractorBinSize);
+            glm::vec2 end = glm::floor((a.position + glm::vec2(a.radius, a.radius) - min) / attractorBinSize);
+
+            for (int y = std::max(0, static_cast<int>(start.y)); y <= std::min(attractorBinsY - 1, static_cast<int>(end.y)); y++)
+            {
+                for (int x = std::max(0, static_cast<int>(start.x)); x <= std::min(attractorBinsX - 1, static_cast<int>(end.x)); x++)
+                {
+                    int binIndex = y * attractorBinsX + x;
+
+                    if (pass == 0)
+                        attractorBinOffsets[binIndex + 1]++;
+                    else
+                        attractorBinEntries[attractorBinOffsets[binIndex]++] = i;
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (int b = 0; b < attractorBinsX * attractorBinsY; b++)
+            {
+                attractorBinOffsets[b + 1] += attractorBinOffsets[b];
+            }
+
+            attractorBinEntries.resize(attractorBinOffsets.back());
+        }
+    }
+
+    // filling moved every offset forward to the start of the next bin, so shift them back
+    for (int b = attractorBinsX * attractorBinsY; b > 0; b--)
+    {
+        attractorBinOffsets[b] = attractorBinOffsets[b - 1];
+    }
+
+    attractorBinOffsets[0] = 0;
+}
+
+void Fluid::Fluid::applyVelocity(Particle *p, Scalar dt)
+{
+    p->position += p->velocity * dt;
+}
+
+void Fluid::Fluid::solvePcisph()
+{
+    pcisphAccelerations.assign(particles.size(), Vec2(0, 0));
+    pcisphPressureScale = getPcisphPressureScale();
+
+    // pressure only has to correct what every other force does this step
+    iterateParticlesThreaded(&Fluid::applyNonPressureForcesThread, options.numThreads);
+
+    // the pressure barely changes between steps so the last step's is a much better guess than none
+    iterateParticlesThreaded(&Fluid::solvePcisphPressureThread, options.numThreads);
+
+    int maxIterations = std::max(options.solverMaxIterations, 1);
+    double tolerance = options.solverTolerance * options.desiredRestDensity * std::max(static_cast<int>(particles.size()), 1);
+    int iteration = 0;
+
+    while (true)
+    {
+        iteration++;
+
+        // the diagnostics keep the density error of the last prediction
+        for (auto &partial : diagnosticsPartials)
+        {
+            partial.densityError = 0;
+            partial.maxDensityError = 0;
+            partial.compression = 0;
+        }
+
+        iterateParticlesThreaded(&Fluid::predictPcisphDensityThread, options.numThreads);
+
+        // only compression is corrected, particles at the surface are always below rest density
+        double compression = 0;
+        for (auto &partial : diagnosticsPartials)
+        {
+            compression += partial.compression;
+        }
+
+        if ((compression <= tolerance && iteration >= options.solverMinIterations) || iteration >= maxIterations)
+            break;
+
+        iterateParticlesThreaded(&Fluid::solvePcisphPressureThread, options.numThreads);
+    }
+
+    stats.solverIterations = iteration;
+}
+
+void Fluid::Fluid::applyNonPressureForcesThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        applySPHForces(p, dt);
+        applyAttractors(p, dt);
+    }
+}
+
+Fluid::Scalar Fluid::Fluid::getPcisphPressureScale()
+{
+    // how much pressure a unit of density error needs, from a particle with a full neighbourhood,
+    // particles with fewer neighbours would need more but scaling them up blows up sparse regions
+    Scalar restDensity = options.desiredRestDensity;
+    Scalar beta = 2 * dt * dt * options.particleMass * options.particleMass / (restDensity * restDensity);
+    Scalar denominator = beta * getPrototypeGradientSqr();
+
+    // neighbours are corrected at the same time and push each other too, so the full scale overshoots and oscillates
+    return denominator > 0 ? PCISPH_RELAXATION / denominator : 0;
+}
+
+Fluid::Scalar Fluid::Fluid::getPrototypeGradientSqr()
+{
+    Scalar spacing = options.particleRadius * 2 + options.particleSpacing;
+    int extent = static_cast<int>(options.smoothingRadius / spacing) + 1;
+
+    Vec2 sumGradient(0, 0);
+    Scalar sumGradientSqr = 0;
+
+    for (int x = -extent; x <= extent; x++)
+    {
+        for (int y = -extent; y <= extent; y++)
+        {
+            Vec2 offset = Vec2(x, y) * spacing;
+            Scalar distance = glm::length(offset);
+            if (distance == 0 || distance >= options.smoothingRadius)
+                continue;
+
+            ParticleDistance pd{
+                distance,
+                offset / distance,
+            };
+
+            Vec2 gradient = smoothingKernelSpiky.calculateGradient(&pd, options.smoothingRadius) * pd.direction;
+            sumGradient += gradient;
+            sumGradientSqr += glm::dot(gradient, gradient);
+        }
+    }
+
+    return glm::dot(sumGradient, sumGradient) + sumGradientSqr;
+}
+
+void Fluid::Fluid::solvePbf()
+{
+    pbfCorrections.assign(particles.size(), Vec2(0, 0));
+
+    // constraint gradients are scaled by mass over rest density
+    Scalar gradientScale = options.particleMass / options.desiredRestDensity;
+    pbfRelaxation = PBF_SOFTENING * gradientScale * gradientScale * getPrototypeGradientSqr();
+
+    iterateParticlesThreaded(&Fluid::applyNonPressureForcesThread, options.numThreads);
+
+    for (auto p : particles)
+    {
+        p->predictedPosition = p->position + p->velocity * dt;
+        clampPrediction(p);
+    }
+
+    int maxIterations = std::max(options.solverMaxIterations, 1);
+    double tolerance = options.solverTolerance * options.desiredRestDensity * std::max(static_cast<int>(particles.size()), 1);
+    int iteration = 0;
+
+    while (true)
+    {
+        iteration++;
+
+        // the diagnostics keep the density error of the last iteration
+        for (auto &partial : diagnosticsPartials)
+        {
+            partial.densityError = 0;
+            partial.maxDensityError = 0;
+            partial.compression = 0;
+        }
+
+        iterateParticlesThreaded(&Fluid::solvePbfConstraintThread, options.numThreads);
+
+        double compression = 0;
+        for (auto &partial : diagnosticsPartials)
+        {
+            compression += partial.compression;
+        }
+
+        if ((compression <= tolerance && iteration >= options.solverMinIterations) || iteration >= maxIterations)
+            break;
+
+        // corrections read every neighbour's predicted position so are applied once they're all found
+        iterateParticlesThreaded(&Fluid::solvePbfCorrectionThread, options.numThreads);
+        iterateParticlesThreaded(&Fluid::applyPbfCorrectionThread, options.numThreads);
+    }
+
+    stats.solverIterations = iteration;
+}
+
+void Fluid::Fluid::solvePbfConstraintThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    Scalar gradientScale = options.particleMass / options.desiredRestDensity;
+
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        auto &partial = diagnosticsPartials[i / PARTICLE_CHUNK_SIZE];
+
+        Scalar density = 0;
+        Vec2 sumGradient(0, 0);
+        Scalar sumGradientSqr = 0;
+
+        for (auto q : p->neighbours)
+        {
+            Vec2 separation = getSeparation(p->predictedPosition, q.particle->predictedPosition);
+            Scalar distance = glm::length(separation);
+            ParticleDistance pd{
+                distance == 0 ? 1 : distance,
+                distance == 0 ? q.distance.direction : separation / distance,
+            };
+
+            density += q.particle->mass * smoothingKernelPoly6.calculate(&pd, options.smoothingRadius);
+
+            Vec2 gradient = gradientScale * smoothingKernelSpiky.calculateGradient(&pd, options.smoothingRadius) * pd.direction;
+            sumGradient += gradient;
+            sumGradientSqr += glm::dot(gradient, gradient);
+        }
+
+        Scalar densityError = density - options.desiredRestDensity;
+
+        // only compression is a constraint, pulling particles at the surface towards rest density would clump them
+        Scalar constraint = std::max(static_cast<Scalar>(0), densityError / options.desiredRestDensity);
+
+        // the negated multiplier, so like pressure it's positive when compressed
+        p->density = density;
+        p->pressure = constraint / (glm::dot(sumGradient, sumGradient) + sumGradientSqr + pbfRelaxation);
+
+        partial.densityError += std::abs(densityError);
+        partial.maxDensityError = std::max(partial.maxDensityError, static_cast<float>(std::abs(densityError)));
+        partial.compression += std::max(static_cast<Scalar>(0), densityError);
+    }
+}
+
+void Fluid::Fluid::solvePbfCorrectionThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    Scalar gradientScale = options.particleMass / options.desiredRestDensity;
+
+    // artificial pressure is relative to the kernel at a fifth of the smoothing radius
+    ParticleDistance artificialPressureDistance{
+        static_cast<Scalar>(0.2f * options.smoothingRadius),
+        Vec2(1, 0),
+    };
+    Scalar artificialPressureKernel = smoothingKernelPoly6.calculate(&artificialPressureDistance, options.smoothingRadius);
+
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        Vec2 correction(0, 0);
+
+        for (auto q : p->neighbours)
+        {
+            Vec2 separation = getSeparation(p->predictedPosition, q.particle->predictedPosition);
+            Scalar distance = glm::length(separation);
+            ParticleDistance pd{
+                distance == 0 ? 1 : distance,
+                distance == 0 ? q.distance.direction : separation / distance,
+            };
+
+            Scalar artificialPressure = 0;
+            if (options.artificialPressure > 0)
+            {
+                Scalar ratio = smoothingKernelPoly6.calculate(&pd, options.smoothingRadius) / artificialPressureKernel;
+                ratio *= ratio;
+                artificialPressure = options.artificialPressure * ratio * ratio;
+            }
+
+            correction -= (p->pressure + q.particle->pressure + artificialPressure) * gradientScale * smoothingKernelSpiky.calculateGradient(&pd, options.smoothingRadius) * pd.direction;
+        }
+
+        pbfCorrections[i] = correction;
+    }
+}
+
+void Fluid::Fluid::applyPbfCorrectionThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        p->predictedPosition += pbfCorrections[i] * PBF_RELAXATION;
+        clampPrediction(p);
+    }
+}
+
+void Fluid::Fluid::solveImplicitViscosity()
+{
+    int numParticles = particles.size();
+    viscosityTargets.resize(numParticles);
+    viscosityResidual.resize(numParticles);
+    viscosityPreconditioned.resize(numParticles);
+    viscosityDirection.resize(numParticles);
+    viscosityProduct.resize(numParticles);
+    viscosityDiagonals.resize(numParticles);
+    viscosityPartials.assign(diagnosticsPartials.size(), ViscosityPartial{});
+
+    // velocities barely change between steps, so the last step's are the starting guess
+    viscositySolution.resize(numParticles);
+    for (int i = 0; i < numParticles; i++)
+    {
+        viscositySolution[i] = particles[i]->velocity;
+    }
+
+    iterateParticlesThreaded(&Fluid::startViscosityThread, options.numThreads);
+
+    ViscosityPartial start = takeViscosityPartials();
+    Vec2 residualDot(start.dotX, start.dotY);
+    double residualSqr = start.residualSqr;
+    double threshold = static_cast<double>(options.viscosityTolerance) * options.viscosityTolerance * start.residualSqr;
+    int iteration = 0;
+
+    while (residualSqr > threshold && iteration < options.viscosityMaxIterations)
+    {
+        iteration++;
+
+        iterateParticlesThreaded(&Fluid::multiplyViscosityThread, options.numThreads);
+
+        // the axes are separate systems with the same matrix, so each has its own step
+        ViscosityPartial product = takeViscosityPartials();
+        if (!std::isfinite(product.dotX) || !std::isfinite(product.dotY))
+            break;
+
+        viscosityAlpha.x = product.dotX > 0 ? residualDot.x / product.dotX : 0;
+        viscosityAlpha.y = product.dotY > 0 ? residualDot.y / product.dotY : 0;
+
+        iterateParticlesThreaded(&Fluid::stepViscosityThread, options.numThreads);
+
+        ViscosityPartial step = takeViscosityPartials();
+        if (!std::isfinite(step.dotX) || !std::isfinite(step.dotY))
+            break;
+
+        viscosityBeta.x = residualDot.x > 0 ? step.dotX / residualDot.x : 0;
+        viscosityBeta.y = residualDot.y > 0 ? step.dotY / residualDot.y : 0;
+        residualDot = Vec2(step.dotX, step.dotY);
+        residualSqr = step.residualSqr;
+
+        iterateParticlesThreaded(&Fluid::updateViscosityDirectionThread, options.numThreads);
+    }
+
+    iterateParticlesThreaded(&Fluid::applyViscosityThread, options.numThreads);
+    stats.viscosityIterations = iteration;
+}
+
+void Fluid::Fluid::startViscosityThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    Scalar dtViscosity = dt * options.viscosity;
+
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        auto &partial = viscosityPartials[i / PARTICLE_CHUNK_SIZE];
+
+        // particles without neighbours get no forces (see applySPHForces) so they are kept out of the system,
+        // a unit diagonal and zero residual keep them from dividing by zero
+        if (p->density == 0)
+        {
+            viscosityTargets[i] = Vec2(0, 0);
+            viscosityDiagonals[i] = 1;
+            viscositySolution[i] = Vec2(0, 0);
+            viscosityResidual[i] = Vec2(0, 0);
+            viscosityPreconditioned[i] = Vec2(0, 0);
+            viscosityDirection[i] = Vec2(0, 0);
+            continue;
+        }
+
+        // every other force, the iterative solvers' pressure forces are zero here
+        Vec2 forces = Vec2(p->pressureForce) + Vec2(p->pressureNearForce) + Vec2(p->tensionForce);
+        viscosityTargets[i] = p->density * p->velocity + forces * dt;
+
+        Scalar weights = 0;
+        for (auto q : p->neighbours)
+        {
+            if (q.particle != p)
+                weights += smoothingKernelPoly6.calculate(&q.distance, options.smoothingRadius);
+        }
+
+        viscosityDiagonals[i] = p->density + dtViscosity * weights;
+
+        // jacobi preconditioner
+        viscosityResidual[i] = viscosityTargets[i] - applyViscosityOperator(i, viscositySolution);
+        viscosityPreconditioned[i] = viscosityResidual[i] / viscosityDiagonals[i];
+        viscosityDirection[i] = viscosityPreconditioned[i];
+
+        partial.dotX += viscosityResidual[i].x * viscosityPreconditioned[i].x;
+        partial.dotY += viscosityResidual[i].y * viscosityPreconditioned[i].y;
+        partial.residualSqr += glm::dot(viscosityResidual[i], viscosityResidual[i]);
+    }
+}
+
+void Fluid::Fluid::multiplyViscosityThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto &partial = viscosityPartials[i / PARTICLE_CHUNK_SIZE];
+
+        if (particles[i]->density == 0)
+        {
+            viscosityProduct[i] = Vec2(0, 0);
+            continue;
+        }
+
+        viscosityProduct[i] = applyViscosityOperator(i, viscosityDirection);
+
+        partial.dotX += viscosityDirection[i].x * viscosityProduct[i].x;
+        partial.dotY += viscosityDirection[i].y * viscosityProduct[i].y;
+    }
+}
+
+void Fluid::Fluid::stepViscosityThread(int startingParticle, int endingParticle, int threadIndex)
 {
-    p->density = 0;
-
-    for (auto q : p->neighbours)
+    for (int i = startingParticle; i <= endingParticle; i++)
     {
-        p->density += q.particle->mass * smoothingKernelPoly6.calculate(&q.distance, options.smoothingRadius);
-    }
+        auto &partial = viscosityPartials[i / PARTICLE_CHUNK_SIZE];
 
-    p->pressure = options.stiffness * (p->density - options.desiredRestDensity);
+        viscositySolution[i] += viscosityAlpha * viscosityDirection[i];
+        viscosityResidual[i] -= viscosityAlpha * viscosityProduct[i];
+        viscosityPreconditioned[i] = viscosityResidual[i] / viscosityDiagonals[i];
 
-    // limit pressure to 200
-    // to try and prevent blow ups
-    if (p->pressure > options.pressureLimit)
-        p->pressure = options.pressureLimit;
+        partial.dotX += viscosityResidual[i].x * viscosityPreconditioned[i].x;
+        partial.dotY += viscosityResidual[i].y * viscosityPreconditioned[i].y;
+        partial.residualSqr += glm::dot(viscosityResidual[i], viscosityResidual[i]);
+    }
 }
 
-float Fluid::Fluid::solveDensityAtPoint(const glm::vec2 &point)
+void Fluid::Fluid::updateViscosityDirectionThread(int startingParticle, int endingParticle, int threadIndex)
 {
-    float density = 0;
-
-    for (auto p : particles)
+    for (int i = startingParticle; i <= endingParticle; i++)
     {
-        ParticleDistance pd;
-        pd.direction = point - p->position;
-        pd.distance = glm::length(pd.direction);
-        pd.direction /= pd.distance;
-
-        density += p->mass * smoothingKernelPoly6.calculate(&pd, options.smoothingRadius);
+        viscosityDirection[i] = viscosityPreconditioned[i] + viscosityBeta * viscosityDirection[i];
     }
-
-    return density;
 }
 
-void Fluid::Fluid::solvePressureForce(Particle *p)
+void Fluid::Fluid::applyViscosityThread(int startingParticle, int endingParticle, int threadIndex)
 {
-    p->pressureForce = glm::vec2(0, 0);
-
-    for (auto q : p->neighbours)
+    for (int i = startingParticle; i <= endingParticle; i++)
     {
-        float sharedPressure = (p->pressure + q.particle->pressure) / 2;
-        float smoothing = smoothingKernelSpiky.calculateGradient(&q.distance, options.smoothingRadius);
+        auto p = particles[i];
 
-        glm::vec2 pressureForce = sharedPressure * q.distance.direction * q.particle->mass / q.particle->density;
+        if (p->density == 0)
+        {
+            p->viscosityForce = Vec2(0, 0);
+            continue;
+        }
 
-        p->pressureForce += pressureForce * smoothing;
-        p->pressureNearForce += pressureForce * static_cast<float>(std::pow(smoothing, 4));
+        // the force that takes the particle from v* to the solved velocity once every force is applied
+        p->viscosityForce = (p->density * viscositySolution[i] - viscosityTargets[i]) / dt;
     }
-
-    p->pressureForce *= -1;
-    p->pressureNearForce *= -1;
 }
 
-void Fluid::Fluid::solveViscosityForce(Particle *p)
+Fluid::Vec2 Fluid::Fluid::applyViscosityOperator(int i, const std::vector<Vec2> &values)
 {
-    p->viscosityForce = glm::vec2(0, 0);
+    auto p = particles[i];
+    Vec2 laplacian(0, 0);
 
+    // particles are never removed one at a time, so a particle's id is its index
     for (auto q : p->neighbours)
     {
-        p->viscosityForce += (q.particle->velocity - p->velocity) * smoothingKernelPoly6.calculate(&q.distance, options.smoothingRadius);
+        laplacian += (values[i] - values[q.particle->id]) * smoothingKernelPoly6.calculate(&q.distance, options.smoothingRadius);
     }
 
-    p->viscosityForce *= options.viscosity;
+    return p->density * values[i] + laplacian * (dt * options.viscosity);
 }
 
-void Fluid::Fluid::solveTensionForce(Particle *p)
+Fluid::Fluid::ViscosityPartial Fluid::Fluid::takeViscosityPartials()
 {
-    p->tensionForce = glm::vec2(0, 0);
+    ViscosityPartial total{};
 
-    for (auto q : p->neighbours)
+    for (auto &partial : viscosityPartials)
     {
-        float colorFieldNoSmoothingKernel = q.particle->mass * (1 / q.particle->density);
-
-        glm::vec2 n = colorFieldNoSmoothingKernel * smoothingKernelPoly6.calculateGradient(&q.distance, options.smoothingRadius) * q.distance.direction;
-        float modN = glm::length(n);
-
-        if (modN < options.surfaceTensionThreshold)
-            continue;
-
-        glm::vec2 normalizedN = n / modN;
-        float colorFieldLaplacian = colorFieldNoSmoothingKernel * smoothingKernelPoly6.calculateLaplacian(&q.distance, options.smoothingRadius);
-
-        p->tensionForce += -options.surfaceTension * colorFieldLaplacian * normalizedN;
+        total.dotX += partial.dotX;
+        total.dotY += partial.dotY;
+        total.residualSqr += partial.residualSqr;
+        partial = ViscosityPartial{};
     }
-}
 
-void Fluid::Fluid::applyGravity(Particle *p, float dt)
-{
-    p->velocity += options.gravity * dt;
+    return total;
 }
 
-void Fluid::Fluid::applySPHForces(Particle *p, float dt)
+void Fluid::Fluid::clampPrediction(Particle *p)
 {
-    if (p->density == 0)
-    {
+    if (!options.useBoundingBox)
         return;
-    }
 
-    p->velocity += ((p->pressureForce + p->pressureNearForce + p->viscosityForce + p->tensionForce) / p->density) * dt;
+    // predictions that leave the box would spread out in space the particles can't reach,
+    // so compression against the walls would never be corrected
+    if (!options.periodicX)
+        p->predictedPosition.x = std::clamp(p->predictedPosition.x, static_cast<Scalar>(options.boundingBox.min.x), static_cast<Scalar>(options.boundingBox.max.x));
+
+    if (!options.periodicY)
+        p->predictedPosition.y = std::clamp(p->predictedPosition.y, static_cast<Scalar>(options.boundingBox.min.y), static_cast<Scalar>(options.boundingBox.max.y));
 }
 
-void Fluid::Fluid::applyAttractors(Particle *p, float dt)
+void Fluid::Fluid::predictPcisphDensityThread(int startingParticle, int endingParticle, int threadIndex)
 {
-    for (auto a : attractors)
+    for (int i = startingParticle; i <= endingParticle; i++)
     {
-        glm::vec2 pToA = a->position - p->position;
-        float dist = glm::length(pToA);
-        glm::vec2 dir = pToA / dist;
+        auto p = particles[i];
+        auto &partial = diagnosticsPartials[i / PARTICLE_CHUNK_SIZE];
 
-        auto pd = new ParticleDistance{
-            dist,
-            dir,
-        };
+        // neighbours are kept from the start of the step, only their distances are predicted
+        Scalar density = 0;
 
-        if (dist < a->radius)
+        for (auto q : p->neighbours)
         {
-            p->velocity += -a->strength * smoothingKernelPoly6.calculateGradient(pd, a->radius) * dir * dt;
+            Scalar distance = glm::length(getSeparation(p->predictedPosition, q.particle->predictedPosition));
+            ParticleDistance pd{
+                distance == 0 ? 1 : distance,
+                q.distance.direction,
+            };
+
+            density += q.particle->mass * smoothingKernelPoly6.calculate(&pd, options.smoothingRadius);
         }
 
-        delete pd;
+        Scalar densityError = density - options.desiredRestDensity;
+
+        p->density = density;
+        p->pressure = std::max(static_cast<Scalar>(0), p->pressure + pcisphPressureScale * densityError);
+
+        partial.densityError += std::abs(densityError);
+        partial.maxDensityError = std::max(partial.maxDensityError, static_cast<float>(std::abs(densityError)));
+        partial.compression += std::max(static_cast<Scalar>(0), densityError);
     }
 }
 
-void Fluid::Fluid::applyVelocity(Particle *p, float dt)
+void Fluid::Fluid::solvePcisphPressureThread(int startingParticle, int endingParticle, int threadIndex)
 {
-    p->position += p->velocity * dt;
+    Scalar restDensitySqr = options.desiredRestDensity * options.desiredRestDensity;
+
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        Vec2 acceleration(0, 0);
+
+        // symmetric so pressure conserves momentum
+        for (auto q : p->neighbours)
+        {
+            Scalar sharedPressure = (p->pressure + q.particle->pressure) / restDensitySqr;
+            acceleration -= q.particle->mass * sharedPressure * smoothingKernelSpiky.calculateGradient(&q.distance, options.smoothingRadius) * q.distance.direction;
+        }
+
+        pcisphAccelerations[i] = acceleration;
+        p->predictedPosition = p->position + (p->velocity + acceleration * dt) * dt;
+        clampPrediction(p);
+    }
 }
 
 void Fluid::Fluid::applyBoundingBox(Particle *p)
 {
-    if (p->position.x < options.boundingBox.min.x)
+    if (!options.useBoundingBox)
+        return;
+
+    glm::vec2 size = options.boundingBox.max - options.boundingBox.min;
+
+    // wrap around periodic axes
+    if (options.periodicX)
+        p->position.x = options.boundingBox.min.x + wrap(p->position.x - options.boundingBox.min.x, size.x);
+
+    if (options.periodicY)
+        p->position.y = options.boundingBox.min.y + wrap(p->position.y - options.boundingBox.min.y, size.y);
+
+    if (!options.periodicX && p->position.x < options.boundingBox.min.x)
     {
         p->position.x = options.boundingBox.min.x;
         p->velocity.x *= -options.boudingBoxRestitution;
     }
 
-    if (p->position.x > options.boundingBox.max.x)
+    if (!options.periodicX && p->position.x > options.boundingBox.max.x)
     {
         p->position.x = options.boundingBox.max.x;
         p->velocity.x *= -options.boudingBoxRestitution;
     }
 
-    if (p->position.y < options.boundingBox.min.y)
+    if (!options.periodicY && p->position.y < options.boundingBox.min.y)
     {
         p->position.y = options.boundingBox.min.y;
         p->velocity.y *= -options.boudingBoxRestitution;
     }
 
-    if (p->position.y > options.boundingBox.max.y)
+    if (!options.periodicY && p->position.y > options.boundingBox.max.y)
     {
         p->position.y = options.boundingBox.max.y;
         p->velocity.y *= -options.boudingBoxRestitution;
     }
 }
 
-void Fluid::Fluid::iterateGridCellsThreaded(void (Fluid::*func)(glm::vec2, glm::vec2, int), const int numThreads)
+void Fluid::Fluid::applyObstacles(Particle *p)
 {
-    // grid is split into numThreads sections horizontally
-    const glm::vec2 gridDimensions = getGridDimensions();
-    const glm::vec2 cellSectionSize(std::floor(gridDimensions.x / numThreads), gridDimensions.y);
+    if (obstacles == nullptr)
+        return;
 
-    int leftOverX = static_cast<int>(gridDimensions.x) % numThreads;
+    auto sample = obstacles->sample(p->position);
 
-    std::thread threads[numThreads];
+    float penetration = p->radius - sample.distance;
+    if (penetration <= 0)
+        return;
+
+    // push out of the obstacle and reflect velocity going into it
+    Vec2 normal = sample.normal;
+    p->position += normal * static_cast<Scalar>(penetration);
 
-    auto halfSize = cellSectionSize;
-    halfSize.x = std::floor(halfSize.x / 2);
+    Scalar normalVelocity = glm::dot(p->velocity, normal);
+    if (normalVelocity < 0)
+        p->velocity -= (1 + options.obstacleRestitution) * normalVelocity * normal;
+}
 
-    // std::cout << "grid dimensions:" << gridDimensions.x << "," << gridDimensions.y << std::endl;
-    // std::cout << "cell section size:" << cellSectionSize.x << "," << cellSectionSize.y << std::endl;
-    // std::cout << "halfSize:" << halfSize.x << "," << halfSize.y << std::endl;
-    // std::cout << "left over x:" << leftOverX << std::endl;
+void Fluid::Fluid::iterateGridCellsThreaded(void (Fluid::*func)(glm::vec2, glm::vec2, int), const int numThreads)
+{
+    const glm::vec2 gridDimensions = getGridDimensions();
 
-    glm::vec2 current = glm::vec2(0, 0);
+    std::thread threads[numThreads];
     int start[numThreads * 2];
     int end[numThreads * 2];
 
-    for (int i = 0; i < numThreads * 2; i++)
-    {
-        int halfIndex = i % 2;
-        int size = halfSize.x + halfIndex;
-
-        if (halfIndex == 0 && leftOverX > 0)
-        {
-            size += 1;
-            leftOverX -= 1;
-        }
-
-        start[i] = current.x;
-        current.x += size;
-        end[i] = current.x - 1;
-    }
+    getGridSections(numThreads, start, end);
 
     // split each section into half so that we don't
     // read cells on boundaries of 2 sections at the same time
@@ -366,17 +1345,89 @@ void Fluid::Fluid::iterateGridCellsThreaded(void (Fluid::*func)(glm::vec2, glm::
     }
 }
 
+void Fluid::Fluid::getGridSections(const int numThreads, int start[], int end[])
+{
+    // grid is split into numThreads sections horizontally, each split in half,
+    // the last column is the one particles on the right edge of the bounding box are clamped into
+    const int numColumns = static_cast<int>(getGridDimensions().x) + 1;
+    int current = 0;
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        // spread the left over columns over the first sections
+        int size = numColumns / numThreads + (i < numColumns % numThreads ? 1 : 0);
+        int halfSize = size / 2;
+
+        start[i * 2] = current;
+        end[i * 2] = current + halfSize - 1;
+        start[i * 2 + 1] = current + halfSize;
+        end[i * 2 + 1] = current + size - 1;
+
+        current += size;
+    }
+}
+
+void Fluid::Fluid::getThreadPartitions(std::vector<AABB> &partitions)
+{
+    partitions.clear();
+
+    const int numThreads = options.numThreads;
+
+    if (!isGridSparse())
+    {
+        // the neighbour search gives each thread a section of grid columns
+        const glm::vec2 gridDimensions = getGridDimensions();
+        const glm::vec2 cellSize = getCellSize();
+
+        int start[numThreads * 2];
+        int end[numThreads * 2];
+        getGridSections(numThreads, start, end);
+
+        for (int i = 0; i < numThreads; i++)
+        {
+            glm::vec2 min = options.boundingBox.min + glm::vec2(start[i * 2], 0) * cellSize;
+            glm::vec2 max = options.boundingBox.min + glm::vec2(end[i * 2 + 1] + 1, gridDimensions.y) * cellSize;
+
+            partitions.push_back(AABB{min, max});
+        }
+
+        return;
+    }
+
+    // otherwise each thread takes a range of particles, so use the bounds of each range
+    int perThread = getParticlesPerThread(numThreads);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        int start = i * perThread;
+        int end = std::min(start + perThread - 1, static_cast<int>(particles.size()) - 1);
+
+        if (start > end)
+            continue;
+
+        AABB bounds{particles[start]->position, particles[start]->position};
+
+        for (int j = start + 1; j <= end; j++)
+        {
+            bounds.min = glm::min(bounds.min, glm::vec2(particles[j]->position));
+            bounds.max = glm::max(bounds.max, glm::vec2(particles[j]->position));
+        }
+
+        partitions.push_back(bounds);
+    }
+}
+
 void Fluid::Fluid::findNeighboursThread(glm::vec2 startingCell, glm::vec2 endingCell, int threadIndex)
 {
     for (int x = startingCell.x; x <= endingCell.x; x++)
     {
         for (int y = startingCell.y; y <= endingCell.y; y++)
         {
-            auto gridKey = std::make_pair(x, y);
-            if (grid[gridKey].size() == 0)
+            auto cell = findGridCell(std::make_pair(x, y));
+            if (cell == nullptr || cell->size() == 0)
                 continue;
 
-            for (Particle *p : grid[gridKey])
+            for (Particle *p : *cell)
             {
                 p->neighbours = getParticlesOfInfluence(p, options.usePredictedPositions);
             }
@@ -384,10 +1435,19 @@ void Fluid::Fluid::findNeighboursThread(glm::vec2 startingCell, glm::vec2 ending
     }
 }
 
+void Fluid::Fluid::findNeighboursParticlesThread(int startingParticle, int endingParticle, int threadIndex)
+{
+    for (int i = startingParticle; i <= endingParticle; i++)
+    {
+        auto p = particles[i];
+        p->neighbours = getParticlesOfInfluence(p, options.usePredictedPositions);
+    }
+}
+
 void Fluid::Fluid::iterateParticlesThreaded(void (Fluid::*func)(int, int, int), const int numThreads)
 {
     std::thread threads[numThreads];
-    int perThread = particles.size() / numThreads;
+    int perThread = getParticlesPerThread(numThreads);
 
     for (int i = 0; i < numThreads; i++)
     {
@@ -403,12 +1463,28 @@ void Fluid::Fluid::iterateParticlesThreaded(void (Fluid::*func)(int, int, int),
     }
 }
 
+int Fluid::Fluid::getParticlesPerThread(const int numThreads)
+{
+    // round up so the last few particles aren't left out,
+    // then up to whole chunks so a chunk is only ever touched by one thread
+    int perThread = (particles.size() + numThreads - 1) / numThreads;
+    return (perThread + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE * PARTICLE_CHUNK_SIZE;
+}
+
 void Fluid::Fluid::solveDensityPressureThread(int startingParticle, int endingParticle, int threadIndex)
 {
     for (int i = startingParticle; i <= endingParticle; i++)
     {
         auto p = particles[i];
+        auto &partial = diagnosticsPartials[i / PARTICLE_CHUNK_SIZE];
         solveDensityPressure(p);
+
+        float densityError = std::abs(p->density - options.desiredRestDensity);
+        partial.densityError += densityError;
+        partial.maxDensityError = std::max(partial.maxDensityError, densityError);
+
+        if (p->pressure >= options.pressureLimit)
+            partial.pressureClampHits++;
     }
 }
 
@@ -417,8 +1493,21 @@ void Fluid::Fluid::solveForcesThread(int startingParticle, int endingParticle, i
     for (int i = startingParticle; i <= endingParticle; i++)
     {
         auto p = particles[i];
-        solvePressureForce(p);
-        solveViscosityForce(p);
+
+        if (options.solver == SPH_SOLVER)
+        {
+            solvePressureForce(p);
+        }
+        else
+        {
+            p->pressureForce = Vec2(0, 0);
+            p->pressureNearForce = Vec2(0, 0);
+        }
+
+        // implicit viscosity is solved once every other force is known
+        if (!options.implicitViscosity)
+            solveViscosityForce(p);
+
         // solveTensionForce(p);
     }
 }
@@ -428,10 +1517,35 @@ void Fluid::Fluid::applyForcesThread(int startingParticle, int endingParticle, i
     for (int i = startingParticle; i <= endingParticle; i++)
     {
         auto p = particles[i];
-        applySPHForces(p, dt);
-        applyAttractors(p, dt);
+        auto &partial = diagnosticsPartials[i / PARTICLE_CHUNK_SIZE];
+
+        // pcisph, pbf and flip apply every other force before solving pressure
+        if (options.solver == PCISPH_SOLVER)
+        {
+            p->velocity += pcisphAccelerations[i] * dt;
+        }
+        else if (options.solver == PBF_SOLVER)
+        {
+            p->velocity = (p->predictedPosition - p->position) / dt;
+        }
+        else if (options.solver == FLIP_SOLVER)
+        {
+            flipSolver.transferToParticle(p, options.flipBlend);
+        }
+        else
+        {
+            applySPHForces(p, dt);
+            applyAttractors(p, dt);
+        }
+
         applyVelocity(p, dt);
         applyBoundingBox(p);
+        applyObstacles(p);
+
+        float speedSqr = glm::dot(p->velocity, p->velocity);
+        partial.kineticEnergy += 0.5f * p->mass * speedSqr;
+        partial.potentialEnergy -= p->mass * glm::dot(Vec2(options.gravity), p->position);
+        partial.maxSpeedSqr = std::max(partial.maxSpeedSqr, speedSqr);
     }
 }
 
@@ -467,10 +1581,11 @@ std::vector<Fluid::ParticleNeighbour> Fluid::Fluid::getParticlesOfInfluence(Part
     // return close;
 
     // add all particles in the same cell
-    // no need to check if they're in range
-    // since they're in the same cell
-    // so must be within smoothing radius
-    for (Particle *q : grid[key])
+    // they still need to be checked if they're in range
+    // since the corners of a cell are further apart than the smoothing radius
+    auto sameCell = findGridCell(key);
+
+    for (Particle *q : *sameCell)
     {
         if (p == q)
             continue;
@@ -478,35 +1593,46 @@ std::vector<Fluid::ParticleNeighbour> Fluid::Fluid::getParticlesOfInfluence(Part
         auto pPosition = usePredictedPosition ? p->predictedPosition : p->position;
         auto qPosition = usePredictedPosition ? q->predictedPosition : q->position;
 
-        auto temp = pPosition - qPosition;
+        auto temp = getSeparation(pPosition, qPosition);
+        if (glm::dot(temp, temp) >= smoothingRadiusSqr)
+            continue;
+
         auto len = glm::length(temp);
 
         close.push_back(ParticleNeighbour{
             q,
             ParticleDistance{
                 len == 0 ? 1.0f : len,
-                len == 0 ? randomDirection() : temp / len,
+                len == 0 ? randomDirection(p, q) : temp / len,
             },
         });
     }
 
-    for (int xOff = -1; xOff <= 1; ++xOff)
+    // neighbouring cells, these wrap around periodic axes
+    auto gridDimensions = getGridDimensions();
+
+    int xCells[3];
+    int yCells[3];
+    int numXCells = getNeighbourCells(key.first, options.periodicX, gridDimensions.x, xCells);
+    int numYCells = getNeighbourCells(key.second, options.periodicY, gridDimensions.y, yCells);
+
+    for (int xi = 0; xi < numXCells; ++xi)
     {
-        for (int yOff = -1; yOff <= 1; ++yOff)
+        for (int yi = 0; yi < numYCells; ++yi)
         {
             // skip if we're in the same cell
-            if (xOff == 0 && yOff == 0)
+            if (xCells[xi] == key.first && yCells[yi] == key.second)
                 continue;
 
-            auto gridKey = std::make_pair(key.first + xOff, key.second + yOff);
-            if (grid[gridKey].size() == 0)
+            auto cell = findGridCell(std::make_pair(xCells[xi], yCells[yi]));
+            if (cell == nullptr || cell->size() == 0)
                 continue;
 
-            for (Particle *q : grid[gridKey])
+            for (Particle *q : *cell)
             {
                 auto pPosition = usePredictedPosition ? p->predictedPosition : p->position;
                 auto qPosition = usePredictedPosition ? q->predictedPosition : q->position;
-                auto temp = pPosition - qPosition;
+                auto temp = getSeparation(pPosition, qPosition);
 
                 if (glm::dot(temp, temp) < smoothingRadiusSqr)
                 {
@@ -520,7 +1646,7 @@ std::vector<Fluid::ParticleNeighbour> Fluid::Fluid::getParticlesOfInfluence(Part
                         q,
                         ParticleDistance{
                             len == 0 ? 1.0f : len,
-                            len == 0 ? randomDirection() : temp / len,
+                            len == 0 ? randomDirection(p, q) : temp / len,
                         },
                     });
                 }
@@ -533,10 +1659,17 @@ std::vector<Fluid::ParticleNeighbour> Fluid::Fluid::getParticlesOfInfluence(Part
 
 void Fluid::Fluid::updateGrid(bool usePredictedPositions)
 {
+    // particles are stored in a different grid when switching between dense and sparse
+    if (isGridSparse() != gridWasSparse)
+    {
+        gridValid = false;
+        gridWasSparse = isGridSparse();
+    }
+
     auto gridDimensions = getGridDimensions();
 
     // create grid if it doesn't exist
-    if (grid.size() == 0 || grid.count(std::make_pair(gridDimensions.x, gridDimensions.y)) == 0)
+    if (!isGridSparse() && (grid.size() == 0 || grid.count(std::make_pair(gridDimensions.x, gridDimensions.y)) == 0))
     {
         for (int x = 0; x <= gridDimensions.x; x++)
         {
@@ -547,52 +1680,249 @@ void Fluid::Fluid::updateGrid(bool usePredictedPositions)
         }
     }
 
+    if (!options.useIncrementalGrid || !gridValid)
+    {
+        rebuildGrid(usePredictedPositions);
+        return;
+    }
+
+    // find particles that have changed cell
+    gridMovers.clear();
+
+    for (Particle *p : particles)
+    {
+        if (getGridKey(p, usePredictedPositions) != p->gridKey)
+            gridMovers.push_back(p);
+    }
+
+    stats.gridMoves = gridMovers.size();
+    stats.gridChurn = particles.size() == 0 ? 0.0f : static_cast<float>(gridMovers.size()) / particles.size();
+
+    // moving lots of particles one at a time is slower than starting again
+    if (stats.gridChurn > options.gridRebuildThreshold)
+    {
+        rebuildGrid(usePredictedPositions);
+        return;
+    }
+
+    for (Particle *p : gridMovers)
+    {
+        removeFromGrid(p);
+        insertIntoGrid(p, usePredictedPositions);
+    }
+
+    stats.gridRebuilt = false;
+}
+
+void Fluid::Fluid::rebuildGrid(bool usePredictedPositions)
+{
+    int moves = 0;
+
     // clear all cells
-    for (auto &cell : grid)
+    if (isGridSparse())
+    {
+        spatialHash.clear();
+    }
+    else
     {
-        cell.second.clear();
+        for (auto &cell : grid)
+        {
+            cell.second.clear();
+        }
     }
 
     // populate grid
     for (Particle *p : particles)
     {
+        auto oldKey = p->gridKey;
         insertIntoGrid(p, usePredictedPositions);
+
+        if (p->gridKey != oldKey)
+            moves++;
     }
+
+    gridValid = true;
+
+    stats.gridMoves = moves;
+    stats.gridChurn = particles.size() == 0 ? 0.0f : static_cast<float>(moves) / particles.size();
+    stats.gridRebuilt = true;
 }
 
 glm::vec2 Fluid::Fluid::getGridDimensions()
 {
-    return glm::vec2(
-        (options.boundingBox.max.x - options.boundingBox.min.x) / options.smoothingRadius,
-        (options.boundingBox.max.y - options.boundingBox.min.y) / options.smoothingRadius);
+    auto cellSize = getCellSize();
+
+    glm::vec2 dimensions(
+        (options.boundingBox.max.x - options.boundingBox.min.x) / cellSize.x,
+        (options.boundingBox.max.y - options.boundingBox.min.y) / cellSize.y);
+
+    // periodic axes are a whole number of cells, round to avoid float error
+    if (options.periodicX)
+        dimensions.x = std::round(dimensions.x);
+
+    if (options.periodicY)
+        dimensions.y = std::round(dimensions.y);
+
+    return dimensions;
+}
+
+glm::vec2 Fluid::Fluid::getCellSize()
+{
+    glm::vec2 cellSize(options.smoothingRadius, options.smoothingRadius);
+
+    if (!options.useBoundingBox)
+        return cellSize;
+
+    // periodic axes need a whole number of cells so that the cells line up when wrapping,
+    // so the cells are stretched to fit (they must not be smaller than the smoothing radius)
+    glm::vec2 size = options.boundingBox.max - options.boundingBox.min;
+
+    if (options.periodicX)
+        cellSize.x = size.x / std::max(1.0f, std::floor(size.x / options.smoothingRadius));
+
+    if (options.periodicY)
+        cellSize.y = size.y / std::max(1.0f, std::floor(size.y / options.smoothingRadius));
+
+    return cellSize;
+}
+
+int Fluid::Fluid::getNeighbourCells(int cell, bool periodic, int numCells, int cells[3])
+{
+    int count = 0;
+
+    for (int offset = -1; offset <= 1; offset++)
+    {
+        int neighbour = cell + offset;
+
+        if (periodic && options.useBoundingBox)
+        {
+            neighbour = ((neighbour % numCells) + numCells) % numCells;
+
+            // small domains wrap onto the same cell more than once
+            if (std::find(cells, cells + count, neighbour) != cells + count)
+                continue;
+        }
+
+        cells[count++] = neighbour;
+    }
+
+    return count;
+}
+
+Fluid::Vec2 Fluid::Fluid::getSeparation(const Vec2 &a, const Vec2 &b)
+{
+    Vec2 separation = a - b;
+
+    if (!options.useBoundingBox)
+        return separation;
+
+    // use the closest image of b across periodic axes
+    Vec2 size = options.boundingBox.max - options.boundingBox.min;
+
+    if (options.periodicX)
+        separation.x -= size.x * std::round(separation.x / size.x);
+
+    if (options.periodicY)
+        separation.y -= size.y * std::round(separation.y / size.y);
+
+    return separation;
+}
+
+Fluid::Scalar Fluid::Fluid::wrap(Scalar value, Scalar size)
+{
+    value = std::fmod(value, size);
+    return value < 0 ? value + size : value;
 }
 
 void Fluid::Fluid::insertIntoGrid(Particle *p, bool usePredictedPosition)
 {
     p->gridKey = getGridKey(p, usePredictedPosition);
 
-    if (grid.count(p->gridKey) == 0)
-        grid[p->gridKey] = std::vector<Particle *>();
+    auto &cell = getGridCell(p->gridKey);
+    p->gridIndex = cell.size();
+    cell.push_back(p);
+}
+
+void Fluid::Fluid::removeFromGrid(Particle *p)
+{
+    auto &cell = getGridCell(p->gridKey);
+
+    // swap remove, the last particle in the cell takes the removed particle's slot
+    Particle *last = cell.back();
+    cell[p->gridIndex] = last;
+    last->gridIndex = p->gridIndex;
+    cell.pop_back();
+
+    p->gridIndex = -1;
+}
+
+std::vector<Fluid::Particle *> &Fluid::Fluid::getGridCell(const std::pair<int, int> &key)
+{
+    if (isGridSparse())
+        return spatialHash.getCell(key);
+
+    return grid[key];
+}
+
+std::vector<Fluid::Particle *> *Fluid::Fluid::findGridCell(const std::pair<int, int> &key)
+{
+    if (isGridSparse())
+        return spatialHash.findCell(key);
+
+    // don't use operator[] since this is called from multiple threads
+    auto cell = grid.find(key);
+    if (cell == grid.end())
+        return nullptr;
 
-    grid[p->gridKey].push_back(p);
+    return &cell->second;
 }
 
 std::pair<int, int> Fluid::Fluid::getGridKey(Particle *p, bool usePredictedPosition)
 {
-    int cellWidth = options.smoothingRadius;
-    int cellHeight = options.smoothingRadius;
+    auto cellSize = getCellSize();
+    float cellWidth = cellSize.x;
+    float cellHeight = cellSize.y;
 
+    // without a bounding box cells are relative to the world origin
+    glm::vec2 origin = options.useBoundingBox ? options.boundingBox.min : glm::vec2(0, 0);
+
+    // floor so that positions left of or above the origin get their own cells
     auto position = usePredictedPosition ? p->predictedPosition : p->position;
-    int x = (position.x - options.boundingBox.min.x) / cellWidth;
-    int y = (position.y - options.boundingBox.min.y) / cellHeight;
+    int x = std::floor((position.x - origin.x) / cellWidth);
+    int y = std::floor((position.y - origin.y) / cellHeight);
+
+    if (!options.useBoundingBox)
+        return std::make_pair(x, y);
+
+    auto gridDimensions = getGridDimensions();
+
+    // periodic axes wrap around
+    if (options.periodicX)
+        x = ((x % static_cast<int>(gridDimensions.x)) + static_cast<int>(gridDimensions.x)) % static_cast<int>(gridDimensions.x);
+
+    if (options.periodicY)
+        y = ((y % static_cast<int>(gridDimensions.y)) + static_cast<int>(gridDimensions.y)) % static_cast<int>(gridDimensions.y);
+
+    // the dense grid only has cells inside the bounding box,
+    // particles outside of it are kept in the edge cells
+    if (!isGridSparse())
+    {
+        x = std::clamp(x, 0, static_cast<int>(gridDimensions.x));
+        y = std::clamp(y, 0, static_cast<int>(gridDimensions.y));
+    }
 
     return std::make_pair(x, y);
 }
 
-glm::vec2 Fluid::Fluid::randomDirection()
+Fluid::Vec2 Fluid::Fluid::randomDirection(Particle *p, Particle *q)
 {
-    // std::cout << "random direction" << std::endl;
+    // keyed by the pair and step so it doesn't depend on which thread asks or when,
+    // q gets the opposite direction so the pair is pushed apart evenly
+    int first = std::min(p->id, q->id);
+    int second = std::max(p->id, q->id);
+
+    float angle = Utility::Random::uniform(Utility::Random::hash(first, second, step)) * 2 * std::numbers::pi;
+    Vec2 direction(std::cos(angle), std::sin(angle));
 
-    float angle = static_cast<float>(rand()) / RAND_MAX * 2 * std::numbers::pi;
-    return glm::normalize(glm::vec2(std::cos(angle), std::sin(angle)));
+    return p->id == first ? direction : -direction;
 }
\ No newline at end of file
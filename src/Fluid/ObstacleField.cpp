@@ -0,0 +1,167 @@
+#include "../../include/Fluid/ObstacleField.h"
+
+#include <glm/glm.hpp>
+#include <math.h>
+#include <limits>
+#include <thread>
+
+Fluid::ObstacleField::ObstacleField(AABB bounds, float cellSize) : bounds(bounds), cellSize(cellSize)
+{
+    // one more node than cells on each axis so the field covers the whole bounds
+    width = std::ceil((bounds.max.x - bounds.min.x) / cellSize) + 1;
+    height = std::ceil((bounds.max.y - bounds.min.y) / cellSize) + 1;
+}
+
+void Fluid::ObstacleField::addCircle(const ObstacleCircle &circle)
+{
+    circles.push_back(circle);
+    baked = false;
+}
+
+void Fluid::ObstacleField::addPolygon(const std::vector<glm::vec2> &vertices)
+{
+    polygons.push_back(vertices);
+    baked = false;
+}
+
+void Fluid::ObstacleField::clear()
+{
+    circles.clear();
+    polygons.clear();
+    baked = false;
+}
+
+void Fluid::ObstacleField::bake(const int numThreads)
+{
+    distances.resize(width * height);
+    normals.resize(width * height);
+
+    // distances first since normals are taken from the gradient of the distances
+    std::thread threads[numThreads];
+    int perThread = std::ceil(static_cast<float>(height) / numThreads);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        int start = i * perThread;
+        int end = std::min(start + perThread - 1, height - 1);
+
+        threads[i] = std::thread(&ObstacleField::bakeThread, this, start, end);
+    }
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads[i].join();
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int left = std::max(x - 1, 0);
+            int right = std::min(x + 1, width - 1);
+            int up = std::max(y - 1, 0);
+            int down = std::min(y + 1, height - 1);
+
+            glm::vec2 gradient(distances[y * width + right] - distances[y * width + left],
+                               distances[down * width + x] - distances[up * width + x]);
+
+            float length = glm::length(gradient);
+            normals[y * width + x] = length == 0 ? glm::vec2(0, 0) : gradient / length;
+        }
+    }
+
+    baked = true;
+}
+
+bool Fluid::ObstacleField::isBaked()
+{
+    return baked;
+}
+
+Fluid::ObstacleSample Fluid::ObstacleField::sample(const glm::vec2 &position)
+{
+    glm::vec2 local = (position - bounds.min) / cellSize;
+
+    if (!baked || local.x < 0 || local.y < 0 || local.x >= width - 1 || local.y >= height - 1)
+        return ObstacleSample{std::numeric_limits<float>::max(), glm::vec2(0, 0)};
+
+    int x = local.x;
+    int y = local.y;
+    float tx = local.x - x;
+    float ty = local.y - y;
+
+    int i00 = y * width + x;
+    int i10 = i00 + 1;
+    int i01 = i00 + width;
+    int i11 = i01 + 1;
+
+    float distance = glm::mix(glm::mix(distances[i00], distances[i10], tx), glm::mix(distances[i01], distances[i11], tx), ty);
+    glm::vec2 normal = glm::mix(glm::mix(normals[i00], normals[i10], tx), glm::mix(normals[i01], normals[i11], tx), ty);
+
+    float length = glm::length(normal);
+    if (length != 0)
+        normal /= length;
+
+    return ObstacleSample{distance, normal};
+}
+
+const std::vector<Fluid::ObstacleCircle> &Fluid::ObstacleField::getCircles()
+{
+    return circles;
+}
+
+const std::vector<std::vector<glm::vec2>> &Fluid::ObstacleField::getPolygons()
+{
+    return polygons;
+}
+
+void Fluid::ObstacleField::bakeThread(int startingRow, int endingRow)
+{
+    for (int y = startingRow; y <= endingRow; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            glm::vec2 point = bounds.min + glm::vec2(x, y) * cellSize;
+            distances[y * width + x] = solveShapesDistance(point);
+        }
+    }
+}
+
+float Fluid::ObstacleField::solveShapesDistance(const glm::vec2 &point)
+{
+    float distance = std::numeric_limits<float>::max();
+
+    for (auto &c : circles)
+    {
+        distance = std::min(distance, glm::length(point - c.centre) - c.radius);
+    }
+
+    for (auto &vertices : polygons)
+    {
+        float edgeDistanceSqr = std::numeric_limits<float>::max();
+        bool inside = false;
+
+        for (int i = 0, j = vertices.size() - 1; i < vertices.size(); j = i++)
+        {
+            const glm::vec2 &a = vertices[j];
+            const glm::vec2 &b = vertices[i];
+
+            // distance to edge
+            glm::vec2 edge = b - a;
+            glm::vec2 toPoint = point - a;
+            float t = glm::clamp(glm::dot(toPoint, edge) / glm::dot(edge, edge), 0.0f, 1.0f);
+            glm::vec2 closest = toPoint - edge * t;
+
+            edgeDistanceSqr = std::min(edgeDistanceSqr, glm::dot(closest, closest));
+
+            // crossing test for inside
+            if ((a.y > point.y) != (b.y > point.y) && point.x < a.x + (point.y - a.y) / (b.y - a.y) * (b.x - a.x))
+                inside = !inside;
+        }
+
+        float edgeDistance = std::sqrt(edgeDistanceSqr);
+        distance = std::min(distance, inside ? -edgeDistance : edgeDistance);
+    }
+
+    return distance;
+}
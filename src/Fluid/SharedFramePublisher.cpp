@@ -0,0 +1,77 @@
+#include "../../include/Fluid/SharedFramePublisher.h"
+
+#include <algorithm>
+
+bool Fluid::SharedFramePublisher::open(const std::string &name, int maxParticles, int numSlots)
+{
+    close();
+
+    if (!memory.create(name, SharedFrame::getSize(numSlots, maxParticles)))
+        return false;
+
+    // fresh shared memory is zeroed, so every slot sequence and the latest frame start at 0
+    header = reinterpret_cast<SharedFrame::Header *>(memory.getData());
+    header->version = SharedFrame::VERSION;
+    header->numSlots = numSlots;
+    header->maxParticles = maxParticles;
+    header->slotSize = SharedFrame::getSlotSize(maxParticles);
+    header->arrayStride = SharedFrame::getArrayStride(maxParticles);
+    header->latestFrame.store(0, std::memory_order_relaxed);
+
+    // magic last so readers never see a header that is still being written
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SharedFrame::MAGIC;
+
+    frame = 0;
+
+    return true;
+}
+
+void Fluid::SharedFramePublisher::close()
+{
+    memory.close();
+    header = nullptr;
+}
+
+bool Fluid::SharedFramePublisher::isOpen()
+{
+    return header != nullptr;
+}
+
+void Fluid::SharedFramePublisher::publish(const std::vector<Particle *> &particles, float dt)
+{
+    frame++;
+
+    auto slot = SharedFrame::getSlot(header, frame);
+    uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+
+    // odd while writing
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int numParticles = std::min(static_cast<int>(particles.size()), static_cast<int>(header->maxParticles));
+
+    slot->numParticles = numParticles;
+    slot->frame = frame;
+    slot->dt = dt;
+
+    float *positionX = SharedFrame::getArray(header, slot, SharedFrame::POSITION_X);
+    float *positionY = SharedFrame::getArray(header, slot, SharedFrame::POSITION_Y);
+    float *velocityX = SharedFrame::getArray(header, slot, SharedFrame::VELOCITY_X);
+    float *velocityY = SharedFrame::getArray(header, slot, SharedFrame::VELOCITY_Y);
+    float *density = SharedFrame::getArray(header, slot, SharedFrame::DENSITY);
+
+    for (int i = 0; i < numParticles; i++)
+    {
+        auto p = particles[i];
+
+        positionX[i] = p->position.x;
+        positionY[i] = p->position.y;
+        velocityX[i] = p->velocity.x;
+        velocityY[i] = p->velocity.y;
+        density[i] = p->density;
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->latestFrame.store(frame, std::memory_order_release);
+}
@@ -0,0 +1,72 @@
+#include "../../include/Fluid/SharedFrameReader.h"
+
+bool Fluid::SharedFrameReader::open(const std::string &name)
+{
+    close();
+
+    if (!memory.open(name))
+        return false;
+
+    header = reinterpret_cast<SharedFrame::Header *>(memory.getData());
+
+    bool valid = memory.getSize() >= sizeof(SharedFrame::Header) &&
+                 header->magic == SharedFrame::MAGIC &&
+                 header->version == SharedFrame::VERSION;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (!valid || memory.getSize() < SharedFrame::getSize(header->numSlots, header->maxParticles))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void Fluid::SharedFrameReader::close()
+{
+    memory.close();
+    header = nullptr;
+}
+
+bool Fluid::SharedFrameReader::getLatest(SharedFrameView &view)
+{
+    // retry if the publisher laps us while reading the slot header
+    for (int attempt = 0; attempt < 8; attempt++)
+    {
+        uint64_t frame = header->latestFrame.load(std::memory_order_acquire);
+        if (frame == 0)
+            return false;
+
+        auto slot = SharedFrame::getSlot(header, frame);
+
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence % 2 == 1)
+            continue;
+
+        view.frame = slot->frame;
+        view.numParticles = slot->numParticles;
+        view.dt = slot->dt;
+
+        view.positionX = SharedFrame::getArray(header, slot, SharedFrame::POSITION_X);
+        view.positionY = SharedFrame::getArray(header, slot, SharedFrame::POSITION_Y);
+        view.velocityX = SharedFrame::getArray(header, slot, SharedFrame::VELOCITY_X);
+        view.velocityY = SharedFrame::getArray(header, slot, SharedFrame::VELOCITY_Y);
+        view.density = SharedFrame::getArray(header, slot, SharedFrame::DENSITY);
+
+        view.slot = slot;
+        view.sequence = sequence;
+
+        if (isValid(view))
+            return true;
+    }
+
+    return false;
+}
+
+bool Fluid::SharedFrameReader::isValid(const SharedFrameView &view)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
@@ -3,34 +3,34 @@
 #include <math.h>
 #include <numbers>
 
-float Fluid::SmoothingKernelPoly6::calculate(ParticleDistance *distance, float smoothingRadius)
+Fluid::Scalar Fluid::SmoothingKernelPoly6::calculate(ParticleDistance *distance, Scalar smoothingRadius)
 {
-    float r = distance->distance;
-    float h = smoothingRadius;
+    Scalar r = distance->distance;
+    Scalar h = smoothingRadius;
 
     if (r <= 0.0f || r >= h)
         return 0.0f;
 
-    float volume = (std::numbers::pi * std::pow(h, 8)) / 4.0f;
-    float value = std::fmax(0.0f, std::pow(h, 2) - std::pow(r, 2));
+    Scalar volume = (std::numbers::pi * std::pow(h, 8)) / 4.0f;
+    Scalar value = std::fmax(0.0f, std::pow(h, 2) - std::pow(r, 2));
 
     return std::pow(value, 3) / volume;
 }
 
-float Fluid::SmoothingKernelPoly6::calculateGradient(ParticleDistance *distance, float smoothingRadius)
+Fluid::Scalar Fluid::SmoothingKernelPoly6::calculateGradient(ParticleDistance *distance, Scalar smoothingRadius)
 {
-    float r = distance->distance;
-    float h = smoothingRadius;
+    Scalar r = distance->distance;
+    Scalar h = smoothingRadius;
 
     if (r >= h)
         return 0.0f;
 
-    float f = std::pow(h, 2) - std::pow(r, 2);
-    float scale = -24 / (std::numbers::pi * std::pow(h, 8));
-    return scale * r * static_cast<float>(std::pow(f, 2));
+    Scalar f = std::pow(h, 2) - std::pow(r, 2);
+    Scalar scale = -24 / (std::numbers::pi * std::pow(h, 8));
+    return scale * r * static_cast<Scalar>(std::pow(f, 2));
 }
 
-float Fluid::SmoothingKernelPoly6::calculateLaplacian(ParticleDistance *distance, float smoothingRadius)
+Fluid::Scalar Fluid::SmoothingKernelPoly6::calculateLaplacian(ParticleDistance *distance, Scalar smoothingRadius)
 {
     return 0.0f;
 }
\ No newline at end of file
@@ -3,31 +3,31 @@
 #include <math.h>
 #include <numbers>
 
-float Fluid::SmoothingKernelSpiky::calculate(ParticleDistance *distance, float smoothingRadius)
+Fluid::Scalar Fluid::SmoothingKernelSpiky::calculate(ParticleDistance *distance, Scalar smoothingRadius)
 {
-    float r = distance->distance;
-    float h = smoothingRadius;
+    Scalar r = distance->distance;
+    Scalar h = smoothingRadius;
 
     if (r <= 0.0f || r >= h)
         return 0.0f;
 
-    float volume = (std::numbers::pi * std::pow(h, 4)) / 6;
+    Scalar volume = (std::numbers::pi * std::pow(h, 4)) / 6;
     return std::pow(h - r, 2) / volume;
 }
 
-float Fluid::SmoothingKernelSpiky::calculateGradient(ParticleDistance *distance, float smoothingRadius)
+Fluid::Scalar Fluid::SmoothingKernelSpiky::calculateGradient(ParticleDistance *distance, Scalar smoothingRadius)
 {
-    float r = distance->distance;
-    float h = smoothingRadius;
+    Scalar r = distance->distance;
+    Scalar h = smoothingRadius;
 
     if (r <= 0.0f || r >= h)
         return 0.0f;
 
-    float scale = 12 / (std::pow(h, 4) * std::numbers::pi);
+    Scalar scale = 12 / (std::pow(h, 4) * std::numbers::pi);
     return (r - h) * scale;
 }
 
-float Fluid::SmoothingKernelSpiky::calculateLaplacian(ParticleDistance *distance, float smoothingRadius)
+Fluid::Scalar Fluid::SmoothingKernelSpiky::calculateLaplacian(ParticleDistance *distance, Scalar smoothingRadius)
 {
     return 0.0f;
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "../../include/Fluid/SpatialHash.h"
+
+void Fluid::SpatialHash::clear()
+{
+    // keep the table at less than half full
+    int capacity = 16;
+    while (capacity < numCells * 2)
+    {
+        capacity *= 2;
+    }
+
+    for (int i = 0; i < numCells; i++)
+    {
+        cells[i].clear();
+    }
+
+    numCells = 0;
+    rehash(capacity);
+}
+
+Fluid::SpatialHash::Cell &Fluid::SpatialHash::getCell(const std::pair<int, int> &key)
+{
+    if (slotKeys.size() == 0 || (numCells + 1) * 2 > slotKeys.size())
+        rehash(slotKeys.size() == 0 ? 16 : slotKeys.size() * 2);
+
+    uint64_t packed = packKey(key);
+    uint64_t mask = slotKeys.size() - 1;
+    uint64_t slot = hashKey(packed) & mask;
+
+    while (slotCells[slot] != -1)
+    {
+        if (slotKeys[slot] == packed)
+            return cells[slotCells[slot]];
+
+        slot = (slot + 1) & mask;
+    }
+
+    // create new cell, reusing an old one if possible
+    if (numCells == cells.size())
+    {
+        cells.push_back(Cell());
+        cellKeys.push_back(key);
+    }
+
+    cellKeys[numCells] = key;
+    slotKeys[slot] = packed;
+    slotCells[slot] = numCells;
+
+    return cells[numCells++];
+}
+
+Fluid::SpatialHash::Cell *Fluid::SpatialHash::findCell(const std::pair<int, int> &key)
+{
+    if (slotKeys.size() == 0)
+        return nullptr;
+
+    uint64_t packed = packKey(key);
+    uint64_t mask = slotKeys.size() - 1;
+    uint64_t slot = hashKey(packed) & mask;
+
+    while (slotCells[slot] != -1)
+    {
+        if (slotKeys[slot] == packed)
+            return &cells[slotCells[slot]];
+
+        slot = (slot + 1) & mask;
+    }
+
+    return nullptr;
+}
+
+int Fluid::SpatialHash::getNumCells()
+{
+    return numCells;
+}
+
+std::pair<int, int> Fluid::SpatialHash::getCellKey(int index)
+{
+    return cellKeys[index];
+}
+
+Fluid::SpatialHash::Cell &Fluid::SpatialHash::getCellAt(int index)
+{
+    return cells[index];
+}
+
+uint64_t Fluid::SpatialHash::packKey(const std::pair<int, int> &key)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(key.first)) << 32) | static_cast<uint32_t>(key.second);
+}
+
+uint64_t Fluid::SpatialHash::hashKey(uint64_t key)
+{
+    // splitmix64 finalizer, spreads neighbouring cells across the table
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+
+    return key;
+}
+
+void Fluid::SpatialHash::rehash(int capacity)
+{
+    slotKeys.assign(capacity, 0);
+    slotCells.assign(capacity, -1);
+
+    uint64_t mask = capacity - 1;
+
+    for (int i = 0; i < numCells; i++)
+    {
+        uint64_t packed = packKey(cellKeys[i]);
+        uint64_t slot = hashKey(packed) & mask;
+
+        while (slotCells[slot] != -1)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        slotKeys[slot] = packed;
+        slotCells[slot] = i;
+    }
+}
@@ -0,0 +1,84 @@
+#include "../../include/Fluid/Trajectory.h"
+
+#include <algorithm>
+#include <math.h>
+
+uint16_t Fluid::Trajectory::quantise(float value, float min, float max)
+{
+    float t = (value - min) / (max - min);
+    t = std::clamp(t, 0.0f, 1.0f);
+
+    return static_cast<uint16_t>(std::round(t * 65535.0f));
+}
+
+float Fluid::Trajectory::dequantise(uint16_t value, float min, float max)
+{
+    return min + (value / 65535.0f) * (max - min);
+}
+
+void Fluid::Trajectory::writeVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool Fluid::Trajectory::readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (data >= end)
+            return false;
+
+        uint8_t byte = *data++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool Fluid::Trajectory::readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+{
+    uint64_t wide;
+    if (!readVarint(data, end, wide) || wide > UINT32_MAX)
+        return false;
+
+    value = static_cast<uint32_t>(wide);
+    return true;
+}
+
+void Fluid::Trajectory::encodeDeltas(std::vector<uint8_t> &out, const uint16_t *values, const uint16_t *previous, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t delta = static_cast<int32_t>(values[i]) - (previous == nullptr ? 0 : static_cast<int32_t>(previous[i]));
+
+        // zigzag so small negative differences are small too
+        uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+        writeVarint(out, zigzag);
+    }
+}
+
+bool Fluid::Trajectory::decodeDeltas(const uint8_t *&data, const uint8_t *end, uint16_t *values, const uint16_t *previous, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t zigzag;
+        if (!readVarint(data, end, zigzag))
+            return false;
+
+        int32_t delta = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+        values[i] = static_cast<uint16_t>((previous == nullptr ? 0 : previous[i]) + delta);
+    }
+
+    return true;
+}
@@ -0,0 +1,149 @@
+#include "../../include/Fluid/TrajectoryReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool Fluid::TrajectoryReader::open(const std::string &path)
+{
+    close();
+
+    if (!file.open(path))
+        return false;
+
+    const char *data = file.getData();
+    size_t size = file.getSize();
+
+    if (size < sizeof(Trajectory::FileHeader) + sizeof(Trajectory::FileFooter))
+        return false;
+
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, Trajectory::MAGIC, sizeof(Trajectory::MAGIC)) != 0 || header.version != Trajectory::VERSION)
+        return false;
+
+    // a missing footer means the recording wasn't closed
+    Trajectory::FileFooter footer;
+    std::memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+    if (std::memcmp(footer.magic, Trajectory::MAGIC, sizeof(Trajectory::MAGIC)) != 0)
+        return false;
+
+    // the index fills the space between indexOffset and the footer, checked without sums that a corrupt file could overflow
+    if (footer.indexOffset > size - sizeof(footer))
+        return false;
+
+    uint64_t indexSize = size - sizeof(footer) - footer.indexOffset;
+    if (indexSize % sizeof(Trajectory::ChunkIndexEntry) != 0 || footer.numChunks != indexSize / sizeof(Trajectory::ChunkIndexEntry))
+        return false;
+
+    chunkIndex.resize(footer.numChunks);
+    std::memcpy(chunkIndex.data(), data + footer.indexOffset, footer.numChunks * sizeof(Trajectory::ChunkIndexEntry));
+
+    numFrames = 0;
+    for (auto &chunk : chunkIndex)
+    {
+        if (chunk.offset > footer.indexOffset || chunk.size > footer.indexOffset - chunk.offset || chunk.firstFrame != numFrames)
+            return false;
+
+        numFrames += chunk.numFrames;
+    }
+
+    return true;
+}
+
+void Fluid::TrajectoryReader::close()
+{
+    file.close();
+    chunkIndex.clear();
+    numFrames = 0;
+    currentChunk = -1;
+    currentFrameInChunk = -1;
+}
+
+int Fluid::TrajectoryReader::getNumFrames()
+{
+    return numFrames;
+}
+
+int Fluid::TrajectoryReader::getFrameInterval()
+{
+    return header.frameInterval;
+}
+
+Fluid::AABB Fluid::TrajectoryReader::getBounds()
+{
+    return header.bounds;
+}
+
+bool Fluid::TrajectoryReader::readFrame(int frame, TrajectoryFrame &out)
+{
+    if (frame < 0 || frame >= numFrames)
+        return false;
+
+    // find the chunk containing the frame
+    auto chunkIt = std::upper_bound(chunkIndex.begin(), chunkIndex.end(), static_cast<uint64_t>(frame),
+                                    [](uint64_t f, const Trajectory::ChunkIndexEntry &c)
+                                    { return f < c.firstFrame; });
+    int chunk = (chunkIt - chunkIndex.begin()) - 1;
+    int frameInChunk = frame - chunkIndex[chunk].firstFrame;
+
+    // restart from the start of the chunk unless we can carry on decoding
+    if (chunk != currentChunk || frameInChunk < currentFrameInChunk)
+    {
+        currentChunk = chunk;
+        currentFrameInChunk = -1;
+        currentData = reinterpret_cast<const uint8_t *>(file.getData()) + chunkIndex[chunk].offset;
+    }
+
+    while (currentFrameInChunk < frameInChunk)
+    {
+        if (!decodeNextFrame())
+        {
+            currentChunk = -1;
+            return false;
+        }
+    }
+
+    // dequantise
+    int n = chunkIndex[chunk].numParticles;
+    const AABB &bounds = header.bounds;
+    const float v = header.velocityRange;
+    const uint16_t *values = previousQuantised.data();
+
+    out.step = currentStep;
+    out.positions.resize(n);
+    out.velocities.resize(n);
+
+    for (int i = 0; i < n; i++)
+    {
+        out.positions[i] = glm::vec2(Trajectory::dequantise(values[i], bounds.min.x, bounds.max.x),
+                                     Trajectory::dequantise(values[n + i], bounds.min.y, bounds.max.y));
+        out.velocities[i] = glm::vec2(Trajectory::dequantise(values[2 * n + i], -v, v),
+                                      Trajectory::dequantise(values[3 * n + i], -v, v));
+    }
+
+    return true;
+}
+
+bool Fluid::TrajectoryReader::decodeNextFrame()
+{
+    auto &chunk = chunkIndex[currentChunk];
+    const uint8_t *end = reinterpret_cast<const uint8_t *>(file.getData()) + chunk.offset + chunk.size;
+
+    uint64_t step;
+    if (!Trajectory::readVarint(currentData, end, step))
+        return false;
+
+    size_t count = chunk.numParticles * Trajectory::NUM_CHANNELS;
+    quantised.resize(count);
+
+    bool first = currentFrameInChunk == -1;
+    if (!Trajectory::decodeDeltas(currentData, end, quantised.data(), first ? nullptr : previousQuantised.data(), count))
+        return false;
+
+    // previousQuantised always holds the current frame
+    std::swap(quantised, previousQuantised);
+
+    currentStep = step;
+    currentFrameInChunk++;
+
+    return true;
+}
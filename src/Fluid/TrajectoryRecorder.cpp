@@ -0,0 +1,219 @@
+#include "../../include/Fluid/TrajectoryRecorder.h"
+
+#include <cstring>
+#include <iostream>
+
+Fluid::TrajectoryRecorder::TrajectoryRecorder(const std::string &path, AABB bounds, float velocityRange, int frameInterval, int framesPerChunk) : path(path), framesPerChunk(framesPerChunk)
+{
+    std::memcpy(header.magic, Trajectory::MAGIC, sizeof(Trajectory::MAGIC));
+    header.version = Trajectory::VERSION;
+    header.frameInterval = frameInterval;
+    header.bounds = bounds;
+    header.velocityRange = velocityRange;
+}
+
+Fluid::TrajectoryRecorder::~TrajectoryRecorder()
+{
+    close();
+}
+
+bool Fluid::TrajectoryRecorder::open()
+{
+    if (isOpen)
+        return true;
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "Failed to open trajectory file " << path << "." << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    freeFrames.clear();
+    for (int i = 0; i < POOL_SIZE; i++)
+    {
+        freeFrames.push_back(i);
+    }
+
+    chunk = Trajectory::ChunkIndexEntry{};
+    chunkIndex.clear();
+    chunkData.clear();
+    framesWritten = 0;
+
+    closing = false;
+    isOpen = true;
+    writer = std::thread(&TrajectoryRecorder::writeThread, this);
+
+    return true;
+}
+
+void Fluid::TrajectoryRecorder::close()
+{
+    if (!isOpen)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+
+    condition.notify_one();
+    writer.join();
+
+    // index and footer
+    flushChunk();
+
+    Trajectory::FileFooter footer;
+    footer.indexOffset = file.tellp();
+    footer.numChunks = chunkIndex.size();
+    std::memcpy(footer.magic, Trajectory::MAGIC, sizeof(Trajectory::MAGIC));
+
+    file.write(reinterpret_cast<const char *>(chunkIndex.data()), chunkIndex.size() * sizeof(Trajectory::ChunkIndexEntry));
+    file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+    file.close();
+
+    isOpen = false;
+}
+
+void Fluid::TrajectoryRecorder::record(const std::vector<Particle *> &particles)
+{
+    if (!isOpen)
+        return;
+
+    uint64_t currentStep = step++;
+    if (currentStep % header.frameInterval != 0)
+        return;
+
+    int frameIndex;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // don't wait for the writer, drop the frame instead
+        if (freeFrames.size() == 0)
+        {
+            droppedFrames++;
+            return;
+        }
+
+        frameIndex = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    // buffers only grow so copying doesn't allocate once warmed up
+    FrameBuffer &frame = pool[frameIndex];
+    frame.step = currentStep;
+    frame.numParticles = particles.size();
+    frame.positionsX.resize(particles.size());
+    frame.positionsY.resize(particles.size());
+    frame.velocitiesX.resize(particles.size());
+    frame.velocitiesY.resize(particles.size());
+
+    for (int i = 0; i < particles.size(); i++)
+    {
+        frame.positionsX[i] = particles[i]->position.x;
+        frame.positionsY[i] = particles[i]->position.y;
+        frame.velocitiesX[i] = particles[i]->velocity.x;
+        frame.velocitiesY[i] = particles[i]->velocity.y;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedFrames.push_back(frameIndex);
+        recordedFrames++;
+    }
+
+    condition.notify_one();
+}
+
+int Fluid::TrajectoryRecorder::getRecordedFrames()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return recordedFrames;
+}
+
+int Fluid::TrajectoryRecorder::getDroppedFrames()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return droppedFrames;
+}
+
+void Fluid::TrajectoryRecorder::writeThread()
+{
+    while (true)
+    {
+        int frameIndex;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]
+                           { return queuedFrames.size() > 0 || closing; });
+
+            // write everything queued before closing
+            if (queuedFrames.size() == 0)
+                return;
+
+            frameIndex = queuedFrames.front();
+            queuedFrames.pop_front();
+        }
+
+        writeFrame(pool[frameIndex]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeFrames.push_back(frameIndex);
+        }
+    }
+}
+
+void Fluid::TrajectoryRecorder::writeFrame(FrameBuffer &frame)
+{
+    // start a new chunk when the current one is full or the number of particles changes
+    if (chunk.numFrames > 0 && (chunk.numFrames >= framesPerChunk || chunk.numParticles != frame.numParticles))
+        flushChunk();
+
+    int n = frame.numParticles;
+    const AABB &bounds = header.bounds;
+    const float v = header.velocityRange;
+
+    quantised.resize(n * Trajectory::NUM_CHANNELS);
+
+    for (int i = 0; i < n; i++)
+    {
+        quantised[i] = Trajectory::quantise(frame.positionsX[i], bounds.min.x, bounds.max.x);
+        quantised[n + i] = Trajectory::quantise(frame.positionsY[i], bounds.min.y, bounds.max.y);
+        quantised[2 * n + i] = Trajectory::quantise(frame.velocitiesX[i], -v, v);
+        quantised[3 * n + i] = Trajectory::quantise(frame.velocitiesY[i], -v, v);
+    }
+
+    if (chunk.numFrames == 0)
+    {
+        chunk.firstFrame = framesWritten;
+        chunk.numParticles = n;
+    }
+
+    Trajectory::writeVarint(chunkData, frame.step);
+    Trajectory::encodeDeltas(chunkData, quantised.data(), chunk.numFrames == 0 ? nullptr : previousQuantised.data(), quantised.size());
+
+    std::swap(quantised, previousQuantised);
+
+    chunk.numFrames++;
+    framesWritten++;
+}
+
+void Fluid::TrajectoryRecorder::flushChunk()
+{
+    if (chunk.numFrames == 0)
+        return;
+
+    chunk.offset = file.tellp();
+    chunk.size = chunkData.size();
+    file.write(reinterpret_cast<const char *>(chunkData.data()), chunkData.size());
+
+    chunkIndex.push_back(chunk);
+
+    chunk = Trajectory::ChunkIndexEntry{};
+    chunkData.clear();
+}
@@ -0,0 +1,139 @@
+#include "../../include/Fluid/Watchdog.h"
+#include "../../include/Fluid/Checkpoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    const char *REASON_NAMES[] = {"non finite values", "max speed", "energy growth", "density error"};
+}
+
+Fluid::Watchdog::Watchdog(const WatchdogOptions &options) : options(options)
+{
+    snapshots.resize(std::max(options.numSnapshots, 1));
+}
+
+bool Fluid::Watchdog::check(const FluidDiagnostics &diagnostics, float totalMass)
+{
+    lastStep = diagnostics.step;
+
+    // a nan or inf anywhere in the particles ends up in the sums
+    bool finite = std::isfinite(diagnostics.kineticEnergy) && std::isfinite(diagnostics.potentialEnergy) && std::isfinite(diagnostics.maxDensityError);
+    bool stable = true;
+
+    if (!finite)
+    {
+        lastReason = WATCHDOG_NOT_FINITE;
+        stable = false;
+    }
+    else if (diagnostics.maxSpeed > options.maxSpeed)
+    {
+        lastReason = WATCHDOG_MAX_SPEED;
+        stable = false;
+    }
+    else if (options.maxDensityError > 0 && diagnostics.maxDensityError > options.maxDensityError)
+    {
+        lastReason = WATCHDOG_DENSITY_ERROR;
+        stable = false;
+    }
+    else if (lastKineticEnergy > 0 && diagnostics.kineticEnergy > lastKineticEnergy * options.maxEnergyGrowth)
+    {
+        float minEnergy = 0.5f * totalMass * options.maxEnergyGrowthMinSpeed * options.maxEnergyGrowthMinSpeed;
+
+        if (diagnostics.kineticEnergy > minEnergy)
+        {
+            lastReason = WATCHDOG_ENERGY_GROWTH;
+            stable = false;
+        }
+    }
+
+    if (!stable)
+    {
+        stableSteps = 0;
+        return false;
+    }
+
+    lastKineticEnergy = diagnostics.kineticEnergy;
+
+    if (++stableSteps >= options.recoverySteps && dtScale < 1.0f)
+    {
+        dtScale = std::min(dtScale * 2.0f, 1.0f);
+        stableSteps = 0;
+    }
+
+    return true;
+}
+
+bool Fluid::Watchdog::shouldSnapshot(int step)
+{
+    return step % options.snapshotInterval == 0;
+}
+
+void Fluid::Watchdog::snapshot(int step, const FluidOptions &fluidOptions, const std::vector<Particle *> &particles, const std::vector<FluidAttractor> &attractors)
+{
+    newestSnapshot = (newestSnapshot + 1) % snapshots.size();
+    numSnapshots = std::min(numSnapshots + 1, static_cast<int>(snapshots.size()));
+
+    auto &snapshot = snapshots[newestSnapshot];
+    snapshot.step = step;
+    Checkpoint::write(snapshot.data, fluidOptions, particles, attractors);
+}
+
+const std::vector<char> *Fluid::Watchdog::rollback(int &step)
+{
+    // retry from the same snapshot with a smaller dt first, only go further back once dt can't be lowered
+    if (dtScale > options.minDtScale)
+    {
+        dtScale = std::max(dtScale * 0.5f, options.minDtScale);
+    }
+    else if (numSnapshots > 0)
+    {
+        newestSnapshot = (newestSnapshot - 1 + snapshots.size()) % snapshots.size();
+        numSnapshots--;
+    }
+
+    lastKineticEnergy = -1;
+
+    if (numSnapshots == 0)
+    {
+        if (!failed)
+        {
+            std::cout << "[WATCHDOG]: step " << lastStep << " unstable (" << REASON_NAMES[lastReason] << "), no snapshots left to roll back to" << std::endl;
+            events.push_back(WatchdogEvent{lastStep, lastReason, -1, dtScale});
+        }
+
+        failed = true;
+        return nullptr;
+    }
+
+    auto &snapshot = snapshots[newestSnapshot];
+    step = snapshot.step;
+
+    std::cout << "[WATCHDOG]: step " << lastStep << " unstable (" << REASON_NAMES[lastReason] << "), rolled back to step "
+              << step << " with dt scale " << dtScale << std::endl;
+    events.push_back(WatchdogEvent{lastStep, lastReason, step, dtScale});
+
+    return &snapshot.data;
+}
+
+float Fluid::Watchdog::getDtScale()
+{
+    return dtScale;
+}
+
+bool Fluid::Watchdog::hasFailed()
+{
+    return failed;
+}
+
+const std::vector<Fluid::WatchdogEvent> &Fluid::Watchdog::getEvents()
+{
+    return events;
+}
+
+Fluid::WatchdogOptions &Fluid::Watchdog::getOptions()
+{
+    return options;
+}
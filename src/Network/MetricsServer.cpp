@@ -0,0 +1,116 @@
+#include "../../include/Network/MetricsServer.h"
+
+#include <iostream>
+#include <string>
+
+namespace
+{
+    // requests bigger than this are cut off, only the request line is needed
+    const size_t MAX_REQUEST_SIZE = 4096;
+
+    const sf::Time REQUEST_TIMEOUT = sf::seconds(1.0f);
+    const sf::Time ACCEPT_INTERVAL = sf::milliseconds(50);
+}
+
+Network::MetricsServer::MetricsServer(Utility::MetricsRegistry &registry) : registry(registry)
+{
+}
+
+Network::MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool Network::MetricsServer::start(unsigned short port)
+{
+    stop();
+
+    if (listener.listen(port, sf::IpAddress::LocalHost) != sf::Socket::Done)
+    {
+        std::cout << "Failed to listen for metrics on port " << port << "." << std::endl;
+        return false;
+    }
+
+    listener.setBlocking(false);
+
+    running = true;
+    thread = std::thread(&MetricsServer::run, this);
+
+    return true;
+}
+
+void Network::MetricsServer::stop()
+{
+    if (!running)
+        return;
+
+    running = false;
+    thread.join();
+
+    listener.close();
+}
+
+bool Network::MetricsServer::isRunning()
+{
+    return running;
+}
+
+void Network::MetricsServer::run()
+{
+    while (running)
+    {
+        sf::TcpSocket socket;
+        if (listener.accept(socket) != sf::Socket::Done)
+        {
+            sf::sleep(ACCEPT_INTERVAL);
+            continue;
+        }
+
+        respond(socket);
+        socket.disconnect();
+    }
+}
+
+void Network::MetricsServer::respond(sf::TcpSocket &socket)
+{
+    // read until the end of the headers, giving up on clients that stall
+    sf::SocketSelector selector;
+    selector.add(socket);
+
+    std::string request;
+    char buffer[1024];
+
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE)
+    {
+        if (!selector.wait(REQUEST_TIMEOUT))
+            return;
+
+        size_t received = 0;
+        if (socket.receive(buffer, sizeof(buffer), received) != sf::Socket::Done)
+            return;
+
+        request.append(buffer, received);
+    }
+
+    std::string status;
+    std::string body;
+
+    if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0)
+    {
+        status = "200 OK";
+        body = registry.format();
+    }
+    else
+    {
+        status = "404 Not Found";
+        body = "Not found, metrics are at /metrics\n";
+    }
+
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n"
+                           "\r\n" + body;
+
+    socket.send(response.data(), response.size());
+}
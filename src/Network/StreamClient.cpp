@@ -0,0 +1,162 @@
+#include "../../include/Network/StreamClient.h"
+
+#include <cstring>
+
+bool Network::StreamClient::connect(const std::string &host, unsigned short port, float timeoutSeconds)
+{
+    disconnect();
+
+    if (socket.connect(sf::IpAddress(host), port, sf::seconds(timeoutSeconds)) != sf::Socket::Done)
+        return false;
+
+    connected = true;
+
+    // the hello is the first thing the server sends
+    sf::Clock clock;
+    while (!hasHello)
+    {
+        poll();
+        if (!connected)
+            return false;
+
+        if (clock.getElapsedTime().asSeconds() > timeoutSeconds)
+        {
+            disconnect();
+            return false;
+        }
+
+        sf::sleep(sf::milliseconds(1));
+    }
+
+    return true;
+}
+
+void Network::StreamClient::disconnect()
+{
+    if (connected)
+        socket.disconnect();
+
+    connected = false;
+    hasHello = false;
+    buffer.clear();
+    values.clear();
+    previous.clear();
+    positions.clear();
+}
+
+bool Network::StreamClient::isConnected()
+{
+    return connected;
+}
+
+bool Network::StreamClient::poll()
+{
+    if (!connected)
+        return false;
+
+    socket.setBlocking(false);
+
+    uint8_t chunk[64 * 1024];
+    while (true)
+    {
+        size_t received = 0;
+        auto status = socket.receive(chunk, sizeof(chunk), received);
+
+        if (status == sf::Socket::Done)
+        {
+            buffer.insert(buffer.end(), chunk, chunk + received);
+            continue;
+        }
+
+        if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+            connected = false;
+
+        break;
+    }
+
+    bool newFrame = false;
+    if (!handleMessages(newFrame))
+        disconnect();
+
+    return newFrame;
+}
+
+bool Network::StreamClient::handleMessages(bool &newFrame)
+{
+    size_t offset = 0;
+    StreamProtocol::MessageHeader header;
+
+    while (StreamProtocol::readMessageHeader(buffer.data() + offset, buffer.size() - offset, header))
+    {
+        if (header.size > StreamProtocol::MAX_MESSAGE_SIZE)
+            return false;
+
+        size_t messageSize = StreamProtocol::MESSAGE_HEADER_SIZE + header.size;
+        if (buffer.size() - offset < messageSize)
+            break;
+
+        const uint8_t *payload = buffer.data() + offset + StreamProtocol::MESSAGE_HEADER_SIZE;
+        offset += messageSize;
+
+        if (header.type == StreamProtocol::MessageType::HELLO)
+        {
+            if (header.size != sizeof(StreamProtocol::Hello))
+                return false;
+
+            std::memcpy(&hello, payload, sizeof(hello));
+            if (hello.magic != StreamProtocol::MAGIC || hello.version != StreamProtocol::VERSION)
+                return false;
+
+            hasHello = true;
+        }
+        else if (header.type == StreamProtocol::MessageType::FRAME && hasHello)
+        {
+            int previousBits = frame.bits;
+
+            StreamProtocol::Frame next;
+            if (!StreamProtocol::readFrame(payload, header.size, next, values, previous))
+                return false;
+
+            // deltas are only meaningful against a frame at the same precision
+            if (!next.keyFrame && next.bits != previousBits)
+                return false;
+
+            frame = next;
+            std::swap(previous, values);
+            newFrame = true;
+        }
+    }
+
+    // keep any partial message for next time
+    buffer.erase(buffer.begin(), buffer.begin() + offset);
+
+    if (newFrame)
+        StreamProtocol::dequantisePositions(previous, frame.bits, hello.bounds, positions);
+
+    return true;
+}
+
+const std::vector<glm::vec2> &Network::StreamClient::getPositions()
+{
+    return positions;
+}
+
+uint64_t Network::StreamClient::getFrame()
+{
+    return frame.frame;
+}
+
+int Network::StreamClient::getBits()
+{
+    return frame.bits;
+}
+
+Fluid::AABB Network::StreamClient::getBounds()
+{
+    return hello.bounds;
+}
+
+float Network::StreamClient::getParticleRadius()
+{
+    return hello.particleRadius;
+}
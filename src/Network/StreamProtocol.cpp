@@ -0,0 +1,123 @@
+#include "../../include/Network/StreamProtocol.h"
+#include "../../include/Fluid/Trajectory.h"
+
+#include <cstring>
+
+namespace
+{
+    void writeMessageHeader(std::vector<uint8_t> &out, uint32_t size, uint8_t type)
+    {
+        uint8_t header[Network::StreamProtocol::MESSAGE_HEADER_SIZE];
+        std::memcpy(header, &size, sizeof(size));
+        header[4] = type;
+
+        out.insert(out.end(), header, header + sizeof(header));
+    }
+}
+
+void Network::StreamProtocol::quantisePositions(const std::vector<glm::vec2> &positions, const Fluid::AABB &bounds, std::vector<uint16_t> &out)
+{
+    int n = positions.size();
+    out.resize(n * 2);
+
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = Fluid::Trajectory::quantise(positions[i].x, bounds.min.x, bounds.max.x);
+        out[n + i] = Fluid::Trajectory::quantise(positions[i].y, bounds.min.y, bounds.max.y);
+    }
+}
+
+void Network::StreamProtocol::reducePrecision(const std::vector<uint16_t> &values, int bits, std::vector<uint16_t> &out)
+{
+    out.resize(values.size());
+
+    int shift = 16 - bits;
+    for (int i = 0; i < values.size(); i++)
+    {
+        out[i] = values[i] >> shift;
+    }
+}
+
+void Network::StreamProtocol::dequantisePositions(const std::vector<uint16_t> &values, int bits, const Fluid::AABB &bounds, std::vector<glm::vec2> &out)
+{
+    int n = values.size() / 2;
+    out.resize(n);
+
+    // put reduced values in the middle of the range they cover
+    int shift = 16 - bits;
+    int half = shift == 0 ? 0 : 1 << (shift - 1);
+
+    for (int i = 0; i < n; i++)
+    {
+        out[i].x = Fluid::Trajectory::dequantise((values[i] << shift) + half, bounds.min.x, bounds.max.x);
+        out[i].y = Fluid::Trajectory::dequantise((values[n + i] << shift) + half, bounds.min.y, bounds.max.y);
+    }
+}
+
+void Network::StreamProtocol::writeHello(std::vector<uint8_t> &out, const Hello &hello)
+{
+    writeMessageHeader(out, sizeof(Hello), MessageType::HELLO);
+
+    auto bytes = reinterpret_cast<const uint8_t *>(&hello);
+    out.insert(out.end(), bytes, bytes + sizeof(Hello));
+}
+
+void Network::StreamProtocol::writeFrame(std::vector<uint8_t> &out, const Frame &frame, const uint16_t *values, const uint16_t *previous)
+{
+    // size isn't known until the frame is encoded, so write the header and fill it in after
+    size_t headerStart = out.size();
+    writeMessageHeader(out, 0, MessageType::FRAME);
+
+    size_t payloadStart = out.size();
+
+    Fluid::Trajectory::writeVarint(out, static_cast<uint32_t>(frame.frame));
+    out.push_back(frame.keyFrame ? FrameFlags::KEY_FRAME : 0);
+    out.push_back(static_cast<uint8_t>(frame.bits));
+    Fluid::Trajectory::writeVarint(out, frame.numParticles);
+
+    Fluid::Trajectory::encodeDeltas(out, values, frame.keyFrame ? nullptr : previous, frame.numParticles * 2);
+
+    uint32_t size = out.size() - payloadStart;
+    std::memcpy(&out[headerStart], &size, sizeof(size));
+}
+
+bool Network::StreamProtocol::readMessageHeader(const uint8_t *data, size_t size, MessageHeader &header)
+{
+    if (size < MESSAGE_HEADER_SIZE)
+        return false;
+
+    std::memcpy(&header.size, data, sizeof(header.size));
+    header.type = data[4];
+
+    return true;
+}
+
+bool Network::StreamProtocol::readFrame(const uint8_t *data, size_t size, Frame &frame, std::vector<uint16_t> &values, const std::vector<uint16_t> &previous)
+{
+    const uint8_t *end = data + size;
+
+    uint32_t frameNumber;
+    if (!Fluid::Trajectory::readVarint(data, end, frameNumber) || end - data < 2)
+        return false;
+
+    frame.frame = frameNumber;
+    frame.keyFrame = (*data++ & FrameFlags::KEY_FRAME) != 0;
+    frame.bits = *data++;
+
+    uint32_t numParticles;
+    if (!Fluid::Trajectory::readVarint(data, end, numParticles) || frame.bits < 1 || frame.bits > 16)
+        return false;
+
+    frame.numParticles = numParticles;
+
+    // a delta frame needs the last frame to have had the same particles
+    if (!frame.keyFrame && previous.size() != numParticles * 2)
+        return false;
+
+    // every value takes at least a byte
+    if (end - data < numParticles * 2)
+        return false;
+
+    values.resize(numParticles * 2);
+    return Fluid::Trajectory::decodeDeltas(data, end, values.data(), frame.keyFrame ? nullptr : previous.data(), numParticles * 2);
+}
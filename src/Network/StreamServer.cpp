@@ -0,0 +1,277 @@
+#include "../../include/Network/StreamServer.h"
+
+#include <iostream>
+
+namespace
+{
+    // key frames are sent this often so a corrupted or missed delta doesn't last
+    const int KEY_FRAME_INTERVAL = 120;
+
+    // how many frames in a row a client must be sent before its quality is raised
+    const int RAISE_STREAK = 60;
+
+    const int MIN_BITS = 8;
+    const int MAX_FRAME_INTERVAL = 16;
+}
+
+Network::StreamServer::StreamServer()
+{
+}
+
+Network::StreamServer::~StreamServer()
+{
+    stop();
+}
+
+bool Network::StreamServer::start(unsigned short port, const Fluid::AABB &bounds, float particleRadius)
+{
+    stop();
+
+    if (listener.listen(port) != sf::Socket::Done)
+    {
+        std::cout << "Failed to listen on port " << port << "." << std::endl;
+        return false;
+    }
+
+    listener.setBlocking(false);
+
+    hello = StreamProtocol::Hello{StreamProtocol::MAGIC, StreamProtocol::VERSION, bounds, particleRadius};
+    submittedFrame = 0;
+    frame = 0;
+    droppedFrames = 0;
+
+    running = true;
+    thread = std::thread(&StreamServer::run, this);
+
+    return true;
+}
+
+void Network::StreamServer::stop()
+{
+    if (!running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        running = false;
+    }
+
+    submitted.notify_one();
+    thread.join();
+
+    listener.close();
+
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto client : clients)
+    {
+        client->socket.disconnect();
+        delete client;
+    }
+
+    clients.clear();
+}
+
+bool Network::StreamServer::isRunning()
+{
+    return running;
+}
+
+void Network::StreamServer::submit(const std::vector<Fluid::Particle *> &particles)
+{
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+
+        // overwrites a frame the server hasn't taken yet
+        submittedPositions.resize(particles.size());
+        for (int i = 0; i < particles.size(); i++)
+        {
+            submittedPositions[i] = particles[i]->position;
+        }
+
+        submittedFrame++;
+    }
+
+    submitted.notify_one();
+}
+
+int Network::StreamServer::getNumClients()
+{
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    return clients.size();
+}
+
+std::vector<Network::StreamClientStats> Network::StreamServer::getClientStats()
+{
+    std::lock_guard<std::mutex> lock(clientsMutex);
+
+    std::vector<StreamClientStats> stats;
+    for (auto client : clients)
+    {
+        stats.push_back(StreamClientStats{client->bits, client->frameInterval, client->framesSent, client->framesDropped});
+    }
+
+    return stats;
+}
+
+int Network::StreamServer::getDroppedFrames()
+{
+    return droppedFrames;
+}
+
+void Network::StreamServer::run()
+{
+    while (running)
+    {
+        bool hasFrame = false;
+
+        {
+            // wake up regularly to accept clients and keep sending even without new frames
+            std::unique_lock<std::mutex> lock(submitMutex);
+            submitted.wait_for(lock, std::chrono::milliseconds(5), [&]
+                               { return submittedFrame != frame || !running; });
+
+            if (submittedFrame != frame)
+            {
+                std::swap(positions, submittedPositions);
+                frame = submittedFrame;
+                hasFrame = true;
+            }
+        }
+
+        acceptClients();
+
+        std::lock_guard<std::mutex> lock(clientsMutex);
+
+        if (hasFrame)
+            StreamProtocol::quantisePositions(positions, hello.bounds, quantised);
+
+        for (int i = 0; i < clients.size(); i++)
+        {
+            auto client = clients[i];
+
+            if (hasFrame)
+                sendFrame(client, frame);
+
+            if (!flushClient(client))
+            {
+                delete client;
+                clients.erase(clients.begin() + i);
+                i--;
+            }
+        }
+    }
+}
+
+void Network::StreamServer::acceptClients()
+{
+    while (true)
+    {
+        auto client = new Client();
+
+        if (listener.accept(client->socket) != sf::Socket::Done)
+        {
+            delete client;
+            return;
+        }
+
+        client->socket.setBlocking(false);
+        StreamProtocol::writeHello(client->pending, hello);
+
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clients.push_back(client);
+    }
+}
+
+bool Network::StreamServer::flushClient(Client *client)
+{
+    while (client->sent < client->pending.size())
+    {
+        size_t sent = 0;
+        auto status = client->socket.send(client->pending.data() + client->sent, client->pending.size() - client->sent, sent);
+
+        client->sent += sent;
+
+        if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+            return false;
+
+        if (status == sf::Socket::NotReady || status == sf::Socket::Partial)
+            break;
+    }
+
+    // everything sent, reuse the buffer
+    if (client->sent == client->pending.size())
+    {
+        client->pending.clear();
+        client->sent = 0;
+    }
+
+    return true;
+}
+
+void Network::StreamServer::sendFrame(Client *client, uint64_t frame)
+{
+    client->framesSinceSent++;
+    if (client->framesSinceSent < client->frameInterval)
+        return;
+
+    // still sending the last frame, drop this one rather than queue it
+    if (!client->pending.empty())
+    {
+        client->framesDropped++;
+        droppedFrames++;
+        adapt(client, true);
+        return;
+    }
+
+    StreamProtocol::reducePrecision(quantised, client->bits, reduced);
+
+    bool keyFrame = client->needsKeyFrame || client->framesSinceKeyFrame >= KEY_FRAME_INTERVAL || client->previous.size() != reduced.size();
+
+    StreamProtocol::Frame header{frame, keyFrame, client->bits, static_cast<int>(reduced.size() / 2)};
+    StreamProtocol::writeFrame(client->pending, header, reduced.data(), client->previous.data());
+
+    std::swap(client->previous, reduced);
+    client->needsKeyFrame = false;
+    client->framesSinceKeyFrame = keyFrame ? 0 : client->framesSinceKeyFrame + 1;
+    client->framesSinceSent = 0;
+    client->framesSent++;
+
+    adapt(client, false);
+}
+
+void Network::StreamServer::adapt(Client *client, bool dropped)
+{
+    if (dropped)
+    {
+        client->sentStreak = 0;
+
+        // cheaper frames first, then fewer of them
+        if (client->bits > MIN_BITS)
+        {
+            client->bits -= 4;
+            client->needsKeyFrame = true;
+        }
+        else if (client->frameInterval < MAX_FRAME_INTERVAL)
+        {
+            client->frameInterval *= 2;
+        }
+
+        return;
+    }
+
+    client->sentStreak++;
+    if (client->sentStreak < RAISE_STREAK)
+        return;
+
+    client->sentStreak = 0;
+
+    if (client->frameInterval > 1)
+    {
+        client->frameInterval /= 2;
+    }
+    else if (client->bits < 16)
+    {
+        client->bits += 4;
+        client->needsKeyFrame = true;
+    }
+}
@@ -0,0 +1,81 @@
+#include "../../include/Rendering/DebugDraw.h"
+
+#include <math.h>
+
+void Rendering::DebugDraw::line(glm::vec2 start, glm::vec2 end, const Color &color)
+{
+    sf::Color c(color.r, color.g, color.b, color.a);
+
+    lines.push_back(sf::Vertex(sf::Vector2f(start.x, start.y), c));
+    lines.push_back(sf::Vertex(sf::Vector2f(end.x, end.y), c));
+}
+
+void Rendering::DebugDraw::rect(const Rect &rect, const Color &color, RenderType renderType)
+{
+    glm::vec2 topRight = rect.topLeft + glm::vec2(rect.w, 0);
+    glm::vec2 bottomRight = rect.topLeft + glm::vec2(rect.w, rect.h);
+    glm::vec2 bottomLeft = rect.topLeft + glm::vec2(0, rect.h);
+
+    if (renderType == RenderType::STROKE)
+    {
+        line(rect.topLeft, topRight, color);
+        line(topRight, bottomRight, color);
+        line(bottomRight, bottomLeft, color);
+        line(bottomLeft, rect.topLeft, color);
+        return;
+    }
+
+    sf::Color c(color.r, color.g, color.b, color.a);
+    glm::vec2 corners[] = {rect.topLeft, topRight, bottomRight, rect.topLeft, bottomRight, bottomLeft};
+
+    for (auto &corner : corners)
+    {
+        triangles.push_back(sf::Vertex(sf::Vector2f(corner.x, corner.y), c));
+    }
+}
+
+void Rendering::DebugDraw::circle(const Circle &circle, const Color &color, RenderType renderType, int segments)
+{
+    sf::Color c(color.r, color.g, color.b, color.a);
+
+    for (int i = 0; i < segments; i++)
+    {
+        float a0 = 2.0f * M_PI * i / segments;
+        float a1 = 2.0f * M_PI * (i + 1) / segments;
+
+        glm::vec2 p0 = circle.centre + glm::vec2(std::cos(a0), std::sin(a0)) * circle.radius;
+        glm::vec2 p1 = circle.centre + glm::vec2(std::cos(a1), std::sin(a1)) * circle.radius;
+
+        if (renderType == RenderType::STROKE)
+        {
+            line(p0, p1, color);
+        }
+        else
+        {
+            triangles.push_back(sf::Vertex(sf::Vector2f(circle.centre.x, circle.centre.y), c));
+            triangles.push_back(sf::Vertex(sf::Vector2f(p0.x, p0.y), c));
+            triangles.push_back(sf::Vertex(sf::Vector2f(p1.x, p1.y), c));
+        }
+    }
+}
+
+bool Rendering::DebugDraw::isEmpty()
+{
+    return lines.empty() && triangles.empty();
+}
+
+void Rendering::DebugDraw::clear()
+{
+    // clear keeps the capacity so later frames don't reallocate
+    lines.clear();
+    triangles.clear();
+}
+
+void Rendering::DebugDraw::draw(sf::RenderTarget &target)
+{
+    if (!triangles.empty())
+        target.draw(triangles.data(), triangles.size(), sf::Triangles);
+
+    if (!lines.empty())
+        target.draw(lines.data(), lines.size(), sf::Lines);
+}
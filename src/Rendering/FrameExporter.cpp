@@ -0,0 +1,252 @@
+#include "../../include/Rendering/FrameExporter.h"
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_WRITE_MODE "wb"
+#else
+#define PIPE_WRITE_MODE "w"
+#endif
+
+Rendering::FrameExporter::FrameExporter(const ExportOptions &options) : options(options)
+{
+}
+
+Rendering::FrameExporter::~FrameExporter()
+{
+    finish();
+}
+
+bool Rendering::FrameExporter::start()
+{
+    if (running)
+        return true;
+
+    int numWorkers = options.numWorkers;
+
+    if (options.pipeCommand != "")
+    {
+        pipe = popen(options.pipeCommand.c_str(), PIPE_WRITE_MODE);
+        if (pipe == nullptr)
+        {
+            std::cout << "Failed to start export command." << std::endl;
+            return false;
+        }
+
+        // frames must reach the pipe in order
+        numWorkers = 1;
+    }
+    else if (!isValidPattern(options.outputPattern))
+    {
+        std::cout << "Export pattern must contain exactly one integer conversion such as %05d, use %% for a literal %." << std::endl;
+        return false;
+    }
+
+    freeSlots.clear();
+    for (int i = 0; i < RING_SIZE; i++)
+    {
+        freeSlots.push_back(i);
+    }
+
+    finishing = false;
+    running = true;
+
+    for (int i = 0; i < std::max(numWorkers, 1); i++)
+    {
+        workers.push_back(std::thread(&FrameExporter::workerThread, this));
+    }
+
+    return true;
+}
+
+void Rendering::FrameExporter::submit(const sf::Texture &texture)
+{
+    if (!running)
+        return;
+
+    int slot = acquireSlot();
+    ring[slot].image = texture.copyToImage();
+    queueSlot(slot);
+}
+
+void Rendering::FrameExporter::submit(const uint32_t *pixels, int width, int height)
+{
+    if (!running)
+        return;
+
+    int slot = acquireSlot();
+    auto &opaque = ring[slot].pixels;
+    opaque.resize(width * height);
+
+    for (int i = 0; i < width * height; i++)
+    {
+        uint32_t pixel = pixels[i];
+        uint32_t alpha = pixel >> 24;
+
+        if (alpha == 255)
+        {
+            opaque[i] = pixel;
+            continue;
+        }
+
+        uint32_t r = (pixel & 0xFF) * alpha / 255;
+        uint32_t g = ((pixel >> 8) & 0xFF) * alpha / 255;
+        uint32_t b = ((pixel >> 16) & 0xFF) * alpha / 255;
+        opaque[i] = r | (g << 8) | (b << 16) | 0xFF000000u;
+    }
+
+    ring[slot].image.create(width, height, reinterpret_cast<const sf::Uint8 *>(opaque.data()));
+    queueSlot(slot);
+}
+
+int Rendering::FrameExporter::acquireSlot()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    freeCondition.wait(lock, [&]
+                       { return freeSlots.size() > 0; });
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    return slot;
+}
+
+void Rendering::FrameExporter::queueSlot(int slot)
+{
+    ring[slot].frame = framesSubmitted++;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedSlots.push_back(slot);
+    }
+
+    queuedCondition.notify_one();
+}
+
+void Rendering::FrameExporter::finish()
+{
+    if (!running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishing = true;
+    }
+
+    queuedCondition.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+
+    if (pipe != nullptr)
+    {
+        pclose(pipe);
+        pipe = nullptr;
+    }
+
+    running = false;
+}
+
+int Rendering::FrameExporter::getFramesSubmitted()
+{
+    return framesSubmitted;
+}
+
+int Rendering::FrameExporter::getFramesWritten()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return framesWritten;
+}
+
+bool Rendering::FrameExporter::isValidPattern(const std::string &pattern)
+{
+    int conversions = 0;
+
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+        if (pattern[i] != '%')
+            continue;
+
+        i++;
+        if (i < pattern.size() && pattern[i] == '%')
+            continue;
+
+        // flags and width, but no precision, length modifiers or * widths
+        while (i < pattern.size() && std::strchr("-+ #0", pattern[i]) != nullptr)
+            i++;
+
+        while (i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i])))
+            i++;
+
+        if (i >= pattern.size() || std::strchr("diu", pattern[i]) == nullptr)
+            return false;
+
+        conversions++;
+    }
+
+    return conversions == 1;
+}
+
+void Rendering::FrameExporter::workerThread()
+{
+    while (true)
+    {
+        int slot;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queuedCondition.wait(lock, [&]
+                                 { return queuedSlots.size() > 0 || finishing; });
+
+            // encode everything queued before finishing
+            if (queuedSlots.size() == 0)
+                return;
+
+            slot = queuedSlots.front();
+            queuedSlots.pop_front();
+        }
+
+        bool written = writeFrame(ring[slot]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (written)
+                framesWritten++;
+
+            freeSlots.push_back(slot);
+        }
+
+        freeCondition.notify_one();
+    }
+}
+
+bool Rendering::FrameExporter::writeFrame(Slot &slot)
+{
+    if (pipe != nullptr)
+    {
+        auto size = slot.image.getSize();
+        size_t bytes = size.x * size.y * 4;
+
+        return fwrite(slot.image.getPixelsPtr(), 1, bytes, pipe) == bytes;
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), options.outputPattern.c_str(), slot.frame);
+
+    if (!slot.image.saveToFile(path))
+    {
+        std::cout << "Failed to export frame to " << path << "." << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,146 @@
+#include "../../include/Rendering/Framebuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+Rendering::Framebuffer::Framebuffer(int width, int height)
+{
+    resize(width, height);
+}
+
+void Rendering::Framebuffer::resize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    pixels.assign(width * height, 0);
+
+    // the texture this is uploaded to has to be fully rewritten after a resize
+    dirtyStart = 0;
+    dirtyEnd = height - 1;
+    contentStart = height;
+    contentEnd = -1;
+}
+
+int Rendering::Framebuffer::getWidth()
+{
+    return width;
+}
+
+int Rendering::Framebuffer::getHeight()
+{
+    return height;
+}
+
+uint32_t *Rendering::Framebuffer::getPixels()
+{
+    return pixels.data();
+}
+
+void Rendering::Framebuffer::clear()
+{
+    if (contentStart > contentEnd)
+        return;
+
+    std::fill(pixels.begin() + contentStart * width, pixels.begin() + (contentEnd + 1) * width, 0);
+
+    markDirty(contentStart, contentEnd);
+    contentStart = height;
+    contentEnd = -1;
+}
+
+void Rendering::Framebuffer::pixel(int x, int y, const Color &color)
+{
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return;
+
+    pixels[y * width + x] = pack(color);
+    markDirty(y, y);
+}
+
+void Rendering::Framebuffer::span(int startX, int endX, int y, const Color &color)
+{
+    rect(startX, y, endX - startX + 1, 1, color);
+}
+
+void Rendering::Framebuffer::rect(int x, int y, int w, int h, const Color &color)
+{
+    int startX = std::max(x, 0);
+    int endX = std::min(x + w, width);
+    int startY = std::max(y, 0);
+    int endY = std::min(y + h, height);
+
+    if (startX >= endX || startY >= endY)
+        return;
+
+    uint32_t packed = pack(color);
+
+    for (int row = startY; row < endY; row++)
+    {
+        std::fill(pixels.begin() + row * width + startX, pixels.begin() + row * width + endX, packed);
+    }
+
+    markDirty(startY, endY - 1);
+}
+
+void Rendering::Framebuffer::write(int x, int y, int w, int h, const uint32_t *source)
+{
+    int startX = std::max(x, 0);
+    int endX = std::min(x + w, width);
+    int startY = std::max(y, 0);
+    int endY = std::min(y + h, height);
+
+    if (startX >= endX || startY >= endY)
+        return;
+
+    for (int row = startY; row < endY; row++)
+    {
+        std::memcpy(&pixels[row * width + startX], &source[(row - y) * w + (startX - x)], (endX - startX) * sizeof(uint32_t));
+    }
+
+    markDirty(startY, endY - 1);
+}
+
+void Rendering::Framebuffer::markDirty(int startRow, int endRow)
+{
+    startRow = std::max(startRow, 0);
+    endRow = std::min(endRow, height - 1);
+
+    if (startRow > endRow)
+        return;
+
+    dirtyStart = std::min(dirtyStart, startRow);
+    dirtyEnd = std::max(dirtyEnd, endRow);
+    contentStart = std::min(contentStart, startRow);
+    contentEnd = std::max(contentEnd, endRow);
+}
+
+bool Rendering::Framebuffer::isDirty()
+{
+    return dirtyStart <= dirtyEnd;
+}
+
+int Rendering::Framebuffer::getDirtyStart()
+{
+    return dirtyStart;
+}
+
+int Rendering::Framebuffer::getDirtyEnd()
+{
+    return dirtyEnd;
+}
+
+void Rendering::Framebuffer::clearDirty()
+{
+    dirtyStart = height;
+    dirtyEnd = -1;
+}
+
+uint32_t Rendering::Framebuffer::pack(const Color &color)
+{
+    // RGBA byte order in memory
+    return static_cast<uint32_t>(std::clamp(color.r, 0, 255)) |
+           (static_cast<uint32_t>(std::clamp(color.g, 0, 255)) << 8) |
+           (static_cast<uint32_t>(std::clamp(color.b, 0, 255)) << 16) |
+           (static_cast<uint32_t>(std::clamp(color.a, 0, 255)) << 24);
+}
@@ -3,7 +3,7 @@
 
 #include <iostream>
 #include <math.h>
-#include <stdexcept>
+#include <thread>
 
 Rendering::Renderer::Renderer(std::string windowTitle, int windowWidth, int windowHeight) : windowTitle(windowTitle), windowWidth(windowWidth), windowHeight(windowHeight)
 {
@@ -14,137 +14,277 @@ Rendering::Renderer::~Renderer()
     destroy();
 }
 
-int Rendering::Renderer::init()
+int Rendering::Renderer::init(bool headless)
 {
-    window = new sf::RenderWindow(sf::VideoMode(windowWidth, windowHeight), windowTitle);
+    if (!headless)
+    {
+        window = new sf::RenderWindow(sf::VideoMode(windowWidth, windowHeight), windowTitle);
+        target = window;
+    }
+
+    debugDraw = new DebugDraw();
+
+    return 0;
+}
 
-    // init circle shader
+void Rendering::Renderer::loadCirclesShader()
+{
     circlesShader = new sf::Shader();
     if (!circlesShader->loadFromFile("./Shaders/circles.vert", "./Shaders/circles.frag"))
     {
-        std::cout << "Failed to load circle shader." << std::endl;
-        return 1;
-    }
+        // only shaderCircles needs it, the other circle backends still work
+        std::cout << "Failed to load circle shader, shader circles will be drawn batched." << std::endl;
 
-    return 0;
+        delete circlesShader;
+        circlesShader = nullptr;
+        circlesShaderFailed = true;
+    }
 }
 
 void Rendering::Renderer::destroy()
 {
+    stopExport();
+
+    delete rasterizer;
+    delete rasterBuffer;
+    delete rasterTexture;
+    rasterizer = nullptr;
+    rasterBuffer = nullptr;
+    rasterTexture = nullptr;
+
+    delete pixelBuffer;
+    delete pixelTexture;
+    pixelBuffer = nullptr;
+    pixelTexture = nullptr;
+
+    delete debugDraw;
+    debugDraw = nullptr;
+
+    delete circlesShader;
+    circlesShader = nullptr;
+
+    delete circleVertices;
+    delete circleTexture;
+    circleVertices = nullptr;
+    circleTexture = nullptr;
+
+    if (window == nullptr)
+        return;
+
     window->close();
     delete window;
+    window = nullptr;
 }
 
 bool Rendering::Renderer::pollEvents()
 {
+    bool closed = queueEvents();
+    dispatchEvents();
+
+    return closed;
+}
+
+bool Rendering::Renderer::queueEvents()
+{
+    if (window == nullptr)
+        return false;
+
     sf::Event event;
     while (window->pollEvent(event))
     {
-        void *data = nullptr;
-        RendererEventType type;
+        RendererEvent e;
 
         switch (event.type)
         {
         case sf::Event::Closed:
-            emit(RendererEventType::WINDOW_CLOSE, RendererEvent{RendererEventType::WINDOW_CLOSE, nullptr});
+            events.push(RendererEvent{RendererEventType::WINDOW_CLOSE, std::monostate()});
             return true;
 
         case sf::Event::Resized:
-            type = RendererEventType::WINDOW_RESIZE;
-            data = new glm::vec2(event.size.width, event.size.height);
+            e = RendererEvent{RendererEventType::WINDOW_RESIZE, glm::vec2(event.size.width, event.size.height)};
             break;
 
         case sf::Event::MouseMoved:
-            type = RendererEventType::MOUSE_MOVE;
-            data = new glm::vec2(event.mouseMove.x, event.mouseMove.y);
+            e = RendererEvent{RendererEventType::MOUSE_MOVE, glm::vec2(event.mouseMove.x, event.mouseMove.y)};
             break;
 
         case sf::Event::MouseButtonPressed:
         case sf::Event::MouseButtonReleased:
-            type = event.type == sf::Event::MouseButtonPressed ? RendererEventType::MOUSE_DOWN : RendererEventType::MOUSE_UP;
+        {
+            auto type = event.type == sf::Event::MouseButtonPressed ? RendererEventType::MOUSE_DOWN : RendererEventType::MOUSE_UP;
+            auto button = Utility::MouseButton::MOUSE_UNKNOWN;
 
             if (event.mouseButton.button == sf::Mouse::Left)
             {
-                data = new Utility::MouseButton(Utility::MouseButton::MOUSE_LEFT);
+                button = Utility::MouseButton::MOUSE_LEFT;
             }
             else if (event.mouseButton.button == sf::Mouse::Right)
             {
-                data = new Utility::MouseButton(Utility::MouseButton::MOUSE_RIGHT);
+                button = Utility::MouseButton::MOUSE_RIGHT;
             }
             else if (event.mouseButton.button == sf::Mouse::Middle)
             {
-                data = new Utility::MouseButton(Utility::MouseButton::MOUSE_MIDDLE);
-            }
-            else
-            {
-                data = new Utility::MouseButton(Utility::MouseButton::MOUSE_UNKNOWN);
+                button = Utility::MouseButton::MOUSE_MIDDLE;
             }
 
+            e = RendererEvent{type, button};
             break;
+        }
 
         case sf::Event::KeyPressed:
         case sf::Event::KeyReleased:
-            type = event.type == sf::Event::KeyPressed ? RendererEventType::KEY_DOWN : RendererEventType::KEY_UP;
-            data = new Utility::KeyCode(static_cast<Utility::KeyCode>(event.key.code));
+        {
+            auto type = event.type == sf::Event::KeyPressed ? RendererEventType::KEY_DOWN : RendererEventType::KEY_UP;
+            e = RendererEvent{type, static_cast<Utility::KeyCode>(event.key.code)};
             break;
         }
 
-        emit(type, RendererEvent{type, data});
+        default:
+            // not an event the renderer exposes
+            continue;
+        }
+
+        events.push(e);
     }
 
     return false;
 }
 
-void Rendering::Renderer::clear()
+void Rendering::Renderer::dispatchEvents()
 {
-    window->clear();
+    RendererEvent event;
+    while (events.pop(event))
+    {
+        emit(event.type, event);
+    }
+}
 
-    // setup pixelImage
-    delete pixelImage;
-    pixelImage = new sf::Image();
-    pixelImage->create(windowWidth, windowHeight, sf::Color::Transparent);
+void Rendering::Renderer::clear()
+{
+    if (target != nullptr)
+        target->clear();
+
+    // only the rows drawn to last frame are cleared
+    if (pixelBuffer == nullptr)
+        pixelBuffer = new Framebuffer(windowWidth, windowHeight);
+    else
+        pixelBuffer->clear();
 }
 
 void Rendering::Renderer::present()
 {
-    window->display();
+    if (!debugDraw->isEmpty())
+    {
+        if (target != nullptr)
+            debugDraw->draw(*target);
+
+        debugDraw->clear();
+    }
+
+    if (exportBuffer != nullptr)
+    {
+        // the window, if any, already has the preview drawn to it
+        exporter->submit(exportBuffer->getPixels(), exportBuffer->getWidth(), exportBuffer->getHeight());
+    }
+    else if (isExporting())
+    {
+        exportTexture->display();
+        exporter->submit(exportTexture->getTexture());
+
+        if (window == nullptr)
+            return;
+
+        // preview the exported frame in the window
+        auto exportSize = exportTexture->getSize();
+
+        sf::Sprite preview(exportTexture->getTexture());
+        preview.setScale(static_cast<float>(windowWidth) / exportSize.x, static_cast<float>(windowHeight) / exportSize.y);
+
+        window->clear();
+        window->draw(preview);
+    }
+
+    if (window != nullptr)
+        window->display();
 }
 
 void Rendering::Renderer::presentDrawnPixels()
 {
-    sf::Texture texture;
-    texture.loadFromImage(*pixelImage);
+    drawFramebuffer(pixelBuffer, pixelTexture, glm::vec2(1, 1));
+}
+
+void Rendering::Renderer::pixel(glm::vec2 position, const Color &color)
+{
+    pixelBuffer->pixel(position.x, position.y, color);
+}
+
+void Rendering::Renderer::pixelSpan(int startX, int endX, int y, const Color &color)
+{
+    pixelBuffer->span(startX, endX, y, color);
+}
 
-    sf::Sprite pixelSprite;
-    pixelSprite.setTexture(texture, true);
+void Rendering::Renderer::pixelRect(int x, int y, int w, int h, const Color &color)
+{
+    pixelBuffer->rect(x, y, w, h, color);
+}
 
-    window->draw(pixelSprite);
+Rendering::Framebuffer *Rendering::Renderer::getPixelBuffer()
+{
+    return pixelBuffer;
 }
 
-void Rendering::Renderer::pixel(glm::vec2 position, const Color &color)
+void Rendering::Renderer::drawFramebuffer(Framebuffer *framebuffer, sf::Texture *&texture, glm::vec2 scale)
 {
-    if (position.x < 0 || position.x >= windowWidth || position.y < 0 || position.y >= windowHeight)
+    if (target == nullptr)
+        return;
+
+    sf::Vector2u size(framebuffer->getWidth(), framebuffer->getHeight());
+
+    if (texture == nullptr)
+        texture = new sf::Texture();
+
+    if (texture->getSize() != size)
+    {
+        texture->create(size.x, size.y);
+        framebuffer->markDirty(0, size.y - 1);
+    }
+
+    // only upload the rows that changed
+    if (framebuffer->isDirty())
     {
-        throw std::invalid_argument("Pixel position out of bounds of window.");
+        int start = framebuffer->getDirtyStart();
+        int rows = framebuffer->getDirtyEnd() - start + 1;
+
+        texture->update(reinterpret_cast<const sf::Uint8 *>(framebuffer->getPixels() + start * size.x), size.x, rows, 0, start);
+        framebuffer->clearDirty();
     }
 
-    pixelImage->setPixel(position.x, position.y, sf::Color(color.r, color.g, color.b, color.a));
+    sf::Sprite sprite(*texture);
+    sprite.setScale(1.0f / scale.x, 1.0f / scale.y);
+
+    target->draw(sprite);
 }
 
 void Rendering::Renderer::line(glm::vec2 start, glm::vec2 end, const Color &color)
 {
     sf::Color c(color.r, color.g, color.b, color.a);
 
+    if (target == nullptr)
+        return;
+
     sf::Vertex line[] = {
         sf::Vertex(sf::Vector2f(start.x, start.y), c),
         sf::Vertex(sf::Vector2f(end.x, end.y), c),
     };
 
-    window->draw(line, 2, sf::Lines);
+    target->draw(line, 2, sf::Lines);
 }
 
 void Rendering::Renderer::circle(const Circle &circle, const Color &color, RenderType renderType)
 {
+    if (target == nullptr)
+        return;
+
     sf::CircleShape shape(circle.radius);
     shape.setPointCount(50);
     shape.setPosition(circle.centre.x - circle.radius, circle.centre.y - circle.radius);
@@ -161,11 +301,14 @@ void Rendering::Renderer::circle(const Circle &circle, const Color &color, Rende
         shape.setFillColor(sf::Color::Transparent);
     }
 
-    window->draw(shape);
+    target->draw(shape);
 };
 
 void Rendering::Renderer::rect(const Rect &rect, const Color &color, RenderType renderType)
 {
+    if (target == nullptr)
+        return;
+
     sf::RectangleShape shape(sf::Vector2f(rect.w, rect.h));
     shape.setPosition(rect.topLeft.x, rect.topLeft.y);
 
@@ -181,11 +324,14 @@ void Rendering::Renderer::rect(const Rect &rect, const Color &color, RenderType
         shape.setFillColor(sf::Color::Transparent);
     }
 
-    window->draw(shape);
+    target->draw(shape);
 };
 
 void Rendering::Renderer::polygon(const std::vector<glm::vec2> &vertices, const Color &color, RenderType renderType)
 {
+    if (target == nullptr)
+        return;
+
     sf::ConvexShape shape(vertices.size());
 
     sf::Color c(color.r, color.g, color.b, color.a);
@@ -205,11 +351,29 @@ void Rendering::Renderer::polygon(const std::vector<glm::vec2> &vertices, const
         shape.setPoint(i, sf::Vector2f(vertices[i].x, vertices[i].y));
     }
 
-    window->draw(shape);
+    target->draw(shape);
 };
 
+Rendering::DebugDraw *Rendering::Renderer::getDebugDraw()
+{
+    return debugDraw;
+}
+
 void Rendering::Renderer::shaderCircles(Circle circles[], Color color[], int numCircles)
 {
+    if (circlesShader == nullptr && !circlesShaderFailed)
+        loadCirclesShader();
+
+    if (circlesShader == nullptr)
+    {
+        batchedCircles(circles, color, numCircles);
+        return;
+    }
+
+    // the shader works in target pixels rather than window coordinates
+    glm::vec2 scale = getTargetScale();
+    auto targetSize = target->getSize();
+
     int maxCircles = 500;
     int rendered = 0;
 
@@ -224,23 +388,226 @@ void Rendering::Renderer::shaderCircles(Circle circles[], Color color[], int num
         {
             int ci = rendered + i;
 
-            positions[i] = sf::Glsl::Vec2(circles[ci].centre.x, circles[ci].centre.y);
+            positions[i] = sf::Glsl::Vec2(circles[ci].centre.x * scale.x, circles[ci].centre.y * scale.y);
             colors[i] = sf::Glsl::Vec4(color[ci].r / 255.0f, color[ci].g / 255.0f, color[ci].b / 255.0f, color[ci].a / 255.0f);
         }
 
-        circlesShader->setUniform("u_Radius", circles[0].radius);
+        circlesShader->setUniform("u_Radius", circles[0].radius * scale.x);
         circlesShader->setUniformArray("u_Circles", positions, toRender);
         circlesShader->setUniformArray("u_Colors", colors, toRender);
         circlesShader->setUniform("u_NumCircles", toRender);
-        circlesShader->setUniform("u_Resolution", sf::Glsl::Vec2(windowWidth, windowHeight));
+        circlesShader->setUniform("u_Resolution", sf::Glsl::Vec2(targetSize.x, targetSize.y));
 
         sf::RectangleShape shape(sf::Vector2f(0, 0));
-        window->draw(shape, circlesShader);
+        target->draw(shape, circlesShader);
 
         rendered += toRender;
     }
 };
 
+void Rendering::Renderer::batchedCircles(Circle circles[], Color colors[], int numCircles)
+{
+    if (circleTexture == nullptr)
+        createCircleTexture();
+
+    if (circleVertices == nullptr)
+        circleVertices = new sf::VertexArray(sf::Triangles);
+
+    // resizing keeps the vertex storage so after the first frame nothing is allocated
+    circleVertices->resize(numCircles * 6);
+
+    float textureSize = circleTexture->getSize().x;
+
+    for (int i = 0; i < numCircles; i++)
+    {
+        // reverse order so earlier circles are drawn last and end up on top
+        const Circle &circle = circles[numCircles - 1 - i];
+        const Color &color = colors[numCircles - 1 - i];
+
+        sf::Color c(color.r, color.g, color.b, color.a);
+
+        float left = circle.centre.x - circle.radius;
+        float right = circle.centre.x + circle.radius;
+        float top = circle.centre.y - circle.radius;
+        float bottom = circle.centre.y + circle.radius;
+
+        sf::Vertex *quad = &(*circleVertices)[i * 6];
+
+        quad[0] = sf::Vertex(sf::Vector2f(left, top), c, sf::Vector2f(0, 0));
+        quad[1] = sf::Vertex(sf::Vector2f(right, top), c, sf::Vector2f(textureSize, 0));
+        quad[2] = sf::Vertex(sf::Vector2f(right, bottom), c, sf::Vector2f(textureSize, textureSize));
+        quad[3] = quad[0];
+        quad[4] = quad[2];
+        quad[5] = sf::Vertex(sf::Vector2f(left, bottom), c, sf::Vector2f(0, textureSize));
+    }
+
+    target->draw(*circleVertices, sf::RenderStates(circleTexture));
+}
+
+void Rendering::Renderer::createCircleTexture()
+{
+    int size = 64;
+    float radius = size / 2.0f;
+
+    sf::Image image;
+    image.create(size, size, sf::Color::Transparent);
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            // fade the alpha over the last pixel of the edge for antialiasing
+            float distance = std::sqrt(std::pow(x + 0.5f - radius, 2) + std::pow(y + 0.5f - radius, 2));
+            float alpha = std::max(0.0f, std::min(1.0f, radius - distance + 0.5f));
+
+            image.setPixel(x, y, sf::Color(255, 255, 255, alpha * 255));
+        }
+    }
+
+    circleTexture = new sf::Texture();
+    circleTexture->loadFromImage(image);
+    circleTexture->setSmooth(true);
+    circleTexture->generateMipmap();
+}
+
+void Rendering::Renderer::softwareCircles(Circle circles[], Color colors[], int numCircles, bool metaballs)
+{
+    if (rasterizer == nullptr)
+        rasterizer = new SoftwareRasterizer(std::max(1u, std::thread::hardware_concurrency()));
+
+    // software exports rasterize straight into the exported pixels, otherwise rasterize at the target resolution so exports aren't upscaled
+    Framebuffer *buffer = exportBuffer;
+    glm::vec2 scale;
+
+    if (buffer != nullptr)
+    {
+        scale = glm::vec2(static_cast<float>(buffer->getWidth()) / windowWidth, static_cast<float>(buffer->getHeight()) / windowHeight);
+    }
+    else
+    {
+        scale = getTargetScale();
+        auto targetSize = target->getSize();
+
+        if (rasterBuffer == nullptr || rasterBuffer->getWidth() != targetSize.x || rasterBuffer->getHeight() != targetSize.y)
+        {
+            delete rasterBuffer;
+            rasterBuffer = new Framebuffer(targetSize.x, targetSize.y);
+        }
+
+        buffer = rasterBuffer;
+    }
+
+    buffer->clear();
+
+    if (metaballs)
+        rasterizer->metaballs(*buffer, circles, colors, numCircles, scale);
+    else
+        rasterizer->circles(*buffer, circles, colors, numCircles, scale);
+
+    // the views are in window coordinates so the pixels are scaled back down
+    drawFramebuffer(buffer, rasterTexture, scale);
+}
+
+void Rendering::Renderer::circles(Circle circles[], Color colors[], int numCircles)
+{
+    // a software export has no render texture, so keeps rasterizing in software whatever the backend is switched to
+    if (exportBuffer != nullptr && circlesBackend != CirclesBackend::SOFTWARE_METABALLS)
+        softwareCircles(circles, colors, numCircles);
+    else if (circlesBackend == CirclesBackend::BATCHED_CIRCLES)
+        batchedCircles(circles, colors, numCircles);
+    else if (circlesBackend == CirclesBackend::SHADER_CIRCLES)
+        shaderCircles(circles, colors, numCircles);
+    else
+        softwareCircles(circles, colors, numCircles, circlesBackend == CirclesBackend::SOFTWARE_METABALLS);
+}
+
+void Rendering::Renderer::setCirclesBackend(CirclesBackend backend)
+{
+    circlesBackend = backend;
+}
+
+Rendering::CirclesBackend Rendering::Renderer::getCirclesBackend()
+{
+    return circlesBackend;
+}
+
+bool Rendering::Renderer::startExport(const ExportOptions &options)
+{
+    stopExport();
+
+    // software backends export their pixels directly, so no GL context is needed
+    if (circlesBackend == CirclesBackend::SOFTWARE_CIRCLES || circlesBackend == CirclesBackend::SOFTWARE_METABALLS)
+    {
+        exportBuffer = new Framebuffer(options.width, options.height);
+    }
+    else
+    {
+        exportTexture = new sf::RenderTexture();
+        if (!exportTexture->create(options.width, options.height))
+        {
+            std::cout << "Failed to create export texture." << std::endl;
+
+            delete exportTexture;
+            exportTexture = nullptr;
+            return false;
+        }
+
+        // keep drawing in window coordinates
+        exportTexture->setView(sf::View(sf::FloatRect(0, 0, windowWidth, windowHeight)));
+    }
+
+    exporter = new FrameExporter(options);
+    if (!exporter->start())
+    {
+        delete exporter;
+        delete exportTexture;
+        delete exportBuffer;
+        exporter = nullptr;
+        exportTexture = nullptr;
+        exportBuffer = nullptr;
+        return false;
+    }
+
+    // a software export draws everything but the circles to the window as a preview, or nowhere when headless
+    if (exportTexture != nullptr)
+        target = exportTexture;
+
+    return true;
+}
+
+void Rendering::Renderer::stopExport()
+{
+    if (!isExporting())
+        return;
+
+    exporter->finish();
+
+    delete exporter;
+    delete exportTexture;
+    delete exportBuffer;
+    exporter = nullptr;
+    exportTexture = nullptr;
+    exportBuffer = nullptr;
+
+    target = window;
+}
+
+bool Rendering::Renderer::isExporting()
+{
+    return exporter != nullptr;
+}
+
+int Rendering::Renderer::getExportedFrames()
+{
+    return exporter == nullptr ? 0 : exporter->getFramesWritten();
+}
+
+glm::vec2 Rendering::Renderer::getTargetScale()
+{
+    auto targetSize = target->getSize();
+    return glm::vec2(static_cast<float>(targetSize.x) / windowWidth, static_cast<float>(targetSize.y) / windowHeight);
+}
+
 void Rendering::Renderer::createButton(std::string text, glm::vec2 position, glm::vec2 size, std::function<void()> onClickCallback)
 {
 }
@@ -0,0 +1,247 @@
+#include "../../include/Rendering/SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <thread>
+
+Rendering::SoftwareRasterizer::SoftwareRasterizer(int numThreads, int tileSize) : numThreads(numThreads), tileSize(tileSize)
+{
+}
+
+void Rendering::SoftwareRasterizer::circles(Framebuffer &framebuffer, const Circle circles[], const Color colors[], int numCircles, glm::vec2 scale)
+{
+    setFramebuffer(framebuffer);
+
+    drawCircles = circles;
+    drawColors = colors;
+    drawScale = scale;
+
+    binCircles(circles, numCircles, scale, 1.0f);
+    runTiles(&SoftwareRasterizer::circlesTile);
+
+    framebuffer.markDirty(coveredStart, coveredEnd);
+}
+
+void Rendering::SoftwareRasterizer::metaballs(Framebuffer &framebuffer, const Circle circles[], const Color colors[], int numCircles, glm::vec2 scale, float influence, float threshold)
+{
+    setFramebuffer(framebuffer);
+
+    drawCircles = circles;
+    drawColors = colors;
+    drawScale = scale;
+    drawInfluence = influence;
+    drawThreshold = threshold;
+
+    binCircles(circles, numCircles, scale, influence);
+    runTiles(&SoftwareRasterizer::metaballsTile);
+
+    framebuffer.markDirty(coveredStart, coveredEnd);
+}
+
+void Rendering::SoftwareRasterizer::setFramebuffer(Framebuffer &framebuffer)
+{
+    pixels = framebuffer.getPixels();
+    width = framebuffer.getWidth();
+    height = framebuffer.getHeight();
+
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+}
+
+void Rendering::SoftwareRasterizer::binCircles(const Circle circles[], int numCircles, glm::vec2 scale, float radiusScale)
+{
+    int numTiles = tilesX * tilesY;
+    binOffsets.assign(numTiles + 1, 0);
+
+    coveredStart = height;
+    coveredEnd = -1;
+
+    // count circles in each tile, then turn counts into offsets and fill
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < numCircles; i++)
+        {
+            glm::vec2 centre = circles[i].centre * scale;
+            float radius = circles[i].radius * scale.x * radiusScale;
+
+            int startX = std::max(0, static_cast<int>(std::floor((centre.x - radius) / tileSize)));
+            int endX = std::min(tilesX - 1, static_cast<int>(std::floor((centre.x + radius) / tileSize)));
+            int startY = std::max(0, static_cast<int>(std::floor((centre.y - radius) / tileSize)));
+            int endY = std::min(tilesY - 1, static_cast<int>(std::floor((centre.y + radius) / tileSize)));
+
+            if (pass == 0)
+            {
+                coveredStart = std::min(coveredStart, static_cast<int>(std::floor(centre.y - radius)));
+                coveredEnd = std::max(coveredEnd, static_cast<int>(std::ceil(centre.y + radius)));
+            }
+
+            for (int y = startY; y <= endY; y++)
+            {
+                for (int x = startX; x <= endX; x++)
+                {
+                    int tile = y * tilesX + x;
+
+                    if (pass == 0)
+                        binOffsets[tile + 1]++;
+                    else
+                        binEntries[binOffsets[tile]++] = i;
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (int t = 0; t < numTiles; t++)
+            {
+                binOffsets[t + 1] += binOffsets[t];
+            }
+
+            binEntries.resize(binOffsets[numTiles]);
+        }
+    }
+
+    // filling moved every offset forward to the start of the next tile, so shift them back
+    for (int t = numTiles; t > 0; t--)
+    {
+        binOffsets[t] = binOffsets[t - 1];
+    }
+
+    binOffsets[0] = 0;
+}
+
+void Rendering::SoftwareRasterizer::runTiles(void (SoftwareRasterizer::*func)(int))
+{
+    nextTile = 0;
+
+    auto worker = [this, func]()
+    {
+        int tile;
+        while ((tile = nextTile++) < tilesX * tilesY)
+        {
+            (this->*func)(tile);
+        }
+    };
+
+    std::thread threads[numThreads];
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads[i] = std::thread(worker);
+    }
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        threads[i].join();
+    }
+}
+
+void Rendering::SoftwareRasterizer::circlesTile(int tile)
+{
+    int tileX = (tile % tilesX) * tileSize;
+    int tileY = (tile / tilesX) * tileSize;
+    int tileEndX = std::min(tileX + tileSize, width);
+    int tileEndY = std::min(tileY + tileSize, height);
+
+    // draw back to front so earlier circles end up on top
+    for (int e = binOffsets[tile + 1] - 1; e >= binOffsets[tile]; e--)
+    {
+        int i = binEntries[e];
+
+        glm::vec2 centre = drawCircles[i].centre * drawScale;
+        float radius = drawCircles[i].radius * drawScale.x;
+        float radiusSqr = radius * radius;
+        uint32_t color = Framebuffer::pack(drawColors[i]);
+
+        int startY = std::max(tileY, static_cast<int>(std::ceil(centre.y - radius - 0.5f)));
+        int endY = std::min(tileEndY - 1, static_cast<int>(std::floor(centre.y + radius - 0.5f)));
+
+        for (int y = startY; y <= endY; y++)
+        {
+            // span of the circle on this row, sampled at pixel centres
+            float dy = y + 0.5f - centre.y;
+            float halfWidth = std::sqrt(std::max(0.0f, radiusSqr - dy * dy));
+
+            int startX = std::max(tileX, static_cast<int>(std::ceil(centre.x - halfWidth - 0.5f)));
+            int endX = std::min(tileEndX - 1, static_cast<int>(std::floor(centre.x + halfWidth - 0.5f)));
+
+            if (startX > endX)
+                continue;
+
+            std::fill(pixels + y * width + startX, pixels + y * width + endX + 1, color);
+        }
+    }
+}
+
+void Rendering::SoftwareRasterizer::metaballsTile(int tile)
+{
+    int tileX = (tile % tilesX) * tileSize;
+    int tileY = (tile / tilesX) * tileSize;
+    int tileEndX = std::min(tileX + tileSize, width);
+    int tileEndY = std::min(tileY + tileSize, height);
+    int tileWidth = tileEndX - tileX;
+    int tileHeight = tileEndY - tileY;
+
+    if (binOffsets[tile] == binOffsets[tile + 1])
+        return;
+
+    // density and weighted color channels for every pixel in the tile, reused by the thread for each tile it takes
+    thread_local std::vector<float> field;
+    field.assign(tileWidth * tileHeight * 4, 0.0f);
+
+    float *density = field.data();
+    float *red = density + tileWidth * tileHeight;
+    float *green = red + tileWidth * tileHeight;
+    float *blue = green + tileWidth * tileHeight;
+
+    for (int e = binOffsets[tile]; e < binOffsets[tile + 1]; e++)
+    {
+        int i = binEntries[e];
+
+        glm::vec2 centre = drawCircles[i].centre * drawScale;
+        float radius = drawCircles[i].radius * drawScale.x * drawInfluence;
+        float invRadiusSqr = 1.0f / (radius * radius);
+
+        float r = drawColors[i].r;
+        float g = drawColors[i].g;
+        float b = drawColors[i].b;
+
+        int startX = std::max(tileX, static_cast<int>(std::floor(centre.x - radius)));
+        int endX = std::min(tileEndX - 1, static_cast<int>(std::ceil(centre.x + radius)));
+        int startY = std::max(tileY, static_cast<int>(std::floor(centre.y - radius)));
+        int endY = std::min(tileEndY - 1, static_cast<int>(std::ceil(centre.y + radius)));
+
+        for (int y = startY; y <= endY; y++)
+        {
+            float dy = y + 0.5f - centre.y;
+            int row = (y - tileY) * tileWidth - tileX;
+
+            // branch free so it vectorises, weights outside the kernel clamp to zero
+            for (int x = startX; x <= endX; x++)
+            {
+                float dx = x + 0.5f - centre.x;
+                float q = std::max(0.0f, 1.0f - (dx * dx + dy * dy) * invRadiusSqr);
+                float w = q * q * q;
+
+                density[row + x] += w;
+                red[row + x] += w * r;
+                green[row + x] += w * g;
+                blue[row + x] += w * b;
+            }
+        }
+    }
+
+    for (int y = 0; y < tileHeight; y++)
+    {
+        uint32_t *out = pixels + (tileY + y) * width + tileX;
+
+        for (int x = 0; x < tileWidth; x++)
+        {
+            int i = y * tileWidth + x;
+            if (density[i] < drawThreshold)
+                continue;
+
+            float inv = 1.0f / density[i];
+            out[x] = Framebuffer::pack(Color{static_cast<int>(red[i] * inv), static_cast<int>(green[i] * inv), static_cast<int>(blue[i] * inv), 255});
+        }
+    }
+}
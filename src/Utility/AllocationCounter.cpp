@@ -0,0 +1,38 @@
+#include "../../include/Utility/AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<uint64_t> allocationCount = 0;
+}
+
+uint64_t Utility::getAllocationCount()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+// replaces the global allocation functions to count allocations,
+// the array and nothrow forms call these so they are counted too
+
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
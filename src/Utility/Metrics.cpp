@@ -0,0 +1,135 @@
+#include "../../include/Utility/Metrics.h"
+
+#include <algorithm>
+#include <sstream>
+
+void Utility::Counter::add(uint64_t amount)
+{
+    value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t Utility::Counter::get()
+{
+    return value.load(std::memory_order_relaxed);
+}
+
+void Utility::Gauge::set(double value)
+{
+    this->value.store(value, std::memory_order_relaxed);
+}
+
+double Utility::Gauge::get()
+{
+    return value.load(std::memory_order_relaxed);
+}
+
+Utility::Histogram::Histogram(const std::vector<double> &bounds) : bounds(bounds), buckets(new std::atomic<uint64_t>[bounds.size() + 1])
+{
+    for (int i = 0; i <= bounds.size(); i++)
+    {
+        buckets[i] = 0;
+    }
+}
+
+void Utility::Histogram::observe(double value, uint64_t count)
+{
+    int bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+
+    buckets[bucket].fetch_add(count, std::memory_order_relaxed);
+    this->count.fetch_add(count, std::memory_order_relaxed);
+    sum.fetch_add(value * count, std::memory_order_relaxed);
+}
+
+const std::vector<double> &Utility::Histogram::getBounds()
+{
+    return bounds;
+}
+
+uint64_t Utility::Histogram::getBucket(int i)
+{
+    return buckets[i].load(std::memory_order_relaxed);
+}
+
+uint64_t Utility::Histogram::getCount()
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+double Utility::Histogram::getSum()
+{
+    return sum.load(std::memory_order_relaxed);
+}
+
+Utility::Counter *Utility::MetricsRegistry::addCounter(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    metrics.push_back(Metric{name, help});
+    metrics.back().counter = std::make_unique<Counter>();
+
+    return metrics.back().counter.get();
+}
+
+Utility::Gauge *Utility::MetricsRegistry::addGauge(const std::string &name, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    metrics.push_back(Metric{name, help});
+    metrics.back().gauge = std::make_unique<Gauge>();
+
+    return metrics.back().gauge.get();
+}
+
+Utility::Histogram *Utility::MetricsRegistry::addHistogram(const std::string &name, const std::string &help, const std::vector<double> &bounds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    metrics.push_back(Metric{name, help});
+    metrics.back().histogram = std::make_unique<Histogram>(bounds);
+
+    return metrics.back().histogram.get();
+}
+
+std::string Utility::MetricsRegistry::format()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+
+    for (auto &metric : metrics)
+    {
+        out << "# HELP " << metric.name << " " << metric.help << "\n";
+
+        if (metric.counter)
+        {
+            out << "# TYPE " << metric.name << " counter\n";
+            out << metric.name << " " << metric.counter->get() << "\n";
+        }
+        else if (metric.gauge)
+        {
+            out << "# TYPE " << metric.name << " gauge\n";
+            out << metric.name << " " << metric.gauge->get() << "\n";
+        }
+        else
+        {
+            // buckets are cumulative in the text format
+            auto &histogram = metric.histogram;
+            auto &bounds = histogram->getBounds();
+            uint64_t cumulative = 0;
+
+            out << "# TYPE " << metric.name << " histogram\n";
+
+            for (int i = 0; i < bounds.size(); i++)
+            {
+                cumulative += histogram->getBucket(i);
+                out << metric.name << "_bucket{le=\"" << bounds[i] << "\"} " << cumulative << "\n";
+            }
+
+            cumulative += histogram->getBucket(bounds.size());
+            out << metric.name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+            out << metric.name << "_sum " << histogram->getSum() << "\n";
+            out << metric.name << "_count " << histogram->getCount() << "\n";
+        }
+    }
+
+    return out.str();
+}
@@ -0,0 +1,166 @@
+#include "../../include/Utility/SharedMemory.h"
+
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Utility::SharedMemory::SharedMemory()
+{
+}
+
+Utility::SharedMemory::~SharedMemory()
+{
+    close();
+}
+
+bool Utility::SharedMemory::create(const std::string &name, size_t size)
+{
+    close();
+
+    std::string platformName = getPlatformName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), platformName.c_str());
+    if (mapping == nullptr)
+        return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    mappingHandle = mapping;
+#else
+    // start from a fresh block so readers of an old one don't see a half written layout
+    shm_unlink(platformName.c_str());
+
+    int fd = shm_open(platformName.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd == -1)
+        return false;
+
+    if (ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        shm_unlink(platformName.c_str());
+        return false;
+    }
+
+    void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+    {
+        shm_unlink(platformName.c_str());
+        return false;
+    }
+#endif
+
+    data = static_cast<char *>(view);
+    this->size = size;
+    this->name = platformName;
+    owner = true;
+
+    return true;
+}
+
+bool Utility::SharedMemory::open(const std::string &name)
+{
+    close();
+
+    std::string platformName = getPlatformName(name);
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, platformName.c_str());
+    if (mapping == nullptr)
+        return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(view, &info, sizeof(info));
+
+    mappingHandle = mapping;
+    size = info.RegionSize;
+#else
+    int fd = shm_open(platformName.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return false;
+
+    struct stat memoryStat;
+    if (fstat(fd, &memoryStat) != 0 || memoryStat.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, memoryStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+        return false;
+
+    size = memoryStat.st_size;
+#endif
+
+    data = static_cast<char *>(view);
+    this->name = platformName;
+    owner = false;
+
+    return true;
+}
+
+void Utility::SharedMemory::close()
+{
+    if (data == nullptr)
+        return;
+
+#ifdef _WIN32
+    // the block is freed once every process has closed its handle
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(data, size);
+
+    if (owner)
+        shm_unlink(name.c_str());
+#endif
+
+    data = nullptr;
+    size = 0;
+    owner = false;
+}
+
+char *Utility::SharedMemory::getData()
+{
+    return data;
+}
+
+size_t Utility::SharedMemory::getSize()
+{
+    return size;
+}
+
+std::string Utility::SharedMemory::getPlatformName(const std::string &name)
+{
+#ifdef _WIN32
+    return "Local\\" + name;
+#else
+    // posix names must start with a slash
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+#endif
+}
@@ -0,0 +1,95 @@
+#include "../include/Viewer.h"
+#include "../include/Utility/Timestep.h"
+
+#include <iostream>
+#include <thread>
+
+Viewer::Viewer(std::string windowTitle, int windowWidth, int windowHeight) : windowTitle(windowTitle), windowWidth(windowWidth), windowHeight(windowHeight)
+{
+}
+
+Viewer::~Viewer()
+{
+    delete renderer;
+}
+
+int Viewer::run(const std::string &host, unsigned short port)
+{
+    std::cout << "Connecting to " << host << ":" << port << "..." << std::endl;
+
+    if (!client.connect(host, port))
+    {
+        std::cout << "Failed to connect to " << host << ":" << port << "." << std::endl;
+        return 1;
+    }
+
+    renderer = new Rendering::Renderer(windowTitle, windowWidth, windowHeight);
+    if (renderer->init() != 0)
+    {
+        std::cout << "Failed to initialize renderer." << std::endl;
+        return 1;
+    }
+
+    const int desiredFrameTime = 1000 / 60;
+    uint64_t lastFrame = 0;
+    auto lastPrintTime = timeSinceEpochMillisec();
+
+    while (client.isConnected())
+    {
+        const auto now = timeSinceEpochMillisec();
+
+        if (renderer->pollEvents())
+            break;
+
+        client.poll();
+        render();
+
+        // print stream info once a second
+        if (now - lastPrintTime >= 1000)
+        {
+            std::cout << "\rframe: " << client.getFrame()
+                      << " | frames/s: " << (client.getFrame() - lastFrame) * 1000 / (now - lastPrintTime)
+                      << " | precision: " << client.getBits() << " bits"
+                      << " | particles: " << client.getPositions().size() << "        ";
+
+            lastFrame = client.getFrame();
+            lastPrintTime = now;
+        }
+
+        const auto frameEndTime = now + desiredFrameTime;
+        while (timeSinceEpochMillisec() < frameEndTime)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+
+    std::cout << std::endl
+              << "Disconnected." << std::endl;
+
+    return 0;
+}
+
+void Viewer::render()
+{
+    renderer->clear();
+
+    auto &positions = client.getPositions();
+    float radius = client.getParticleRadius();
+
+    circles.resize(positions.size());
+    colors.resize(positions.size());
+
+    for (int i = 0; i < positions.size(); i++)
+    {
+        circles[i] = Rendering::Circle{positions[i], radius};
+        colors[i] = Rendering::Color{8, 177, 255, 255};
+    }
+
+    renderer->circles(circles.data(), colors.data(), circles.size());
+
+    auto bounds = client.getBounds();
+    renderer->rect(Rendering::Rect{bounds.min, bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y},
+                   Rendering::Color{0, 255, 0, 255}, Rendering::RenderType::STROKE);
+
+    renderer->present();
+}